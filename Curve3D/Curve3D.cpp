@@ -3,150 +3,3251 @@
 #include <cmath>
 #include <algorithm>
 #include <memory>
+#include <new>
 #include <ctime>
 #include <iomanip>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <cstdlib>
+#include <string>
+#include <variant>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory_resource>
+#include <stdexcept>
+#include <type_traits>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CURVE3D_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#define CURVE3D_PREFETCH(address) _mm_prefetch(reinterpret_cast<const char*>(address), _MM_HINT_T0)
+#else
+#define CURVE3D_PREFETCH(address) ((void)0)
+#endif
 
 const double PI = 3.1415926535897932384626433;
 
-class Point3D {
-public:
-    double x, y, z;
-    Point3D(double x, double y, double z) : x(x), y(y), z(z) {}
+#if defined(_MSC_VER)
+#define CURVE3D_TARGET(isa)
+#define CURVE3D_FLATTEN
+#define CURVE3D_INLINE __forceinline
+#else
+#define CURVE3D_TARGET(isa) __attribute__((target(isa)))
+#define CURVE3D_FLATTEN __attribute__((flatten))
+#define CURVE3D_INLINE inline
+#endif
+
+inline double BitsToDouble(uint64_t bits) {
+    double x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+inline uint64_t DoubleToBits(double x) {
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return bits;
+}
+
+inline float BitsToFloat(uint32_t bits) {
+    float x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+inline uint32_t FloatToBits(float x) {
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return bits;
+}
+
+// SIMD packs of doubles sharing one interface, so kernels are written once as
+// templates and instantiated per instruction set. F64x1 is the portable scalar
+// fallback and also handles the tails of every batch.
+struct F64x1 {
+    static const size_t Lanes = 1;
+    typedef double Scalar;
+    typedef bool Mask;
+    double v;
+
+    static F64x1 Set(double x) { return { x }; }
+    static F64x1 Load(const double* p) { return { *p }; }
+    void Store(double* p) const { *p = v; }
+
+    friend F64x1 operator+(const F64x1& a, const F64x1& b) { return { a.v + b.v }; }
+    friend F64x1 operator-(const F64x1& a, const F64x1& b) { return { a.v - b.v }; }
+    friend F64x1 operator*(const F64x1& a, const F64x1& b) { return { a.v * b.v }; }
+    friend F64x1 operator^(const F64x1& a, const F64x1& b) { return { BitsToDouble(DoubleToBits(a.v) ^ DoubleToBits(b.v)) }; }
+    friend F64x1 MulAdd(const F64x1& a, const F64x1& b, const F64x1& c) { return { a.v * b.v + c.v }; }
+    friend F64x1 Abs(const F64x1& a) { return { fabs(a.v) }; }
+    // Same operand rule as minpd/maxpd: b unless a is strictly smaller (larger).
+    friend F64x1 Min(const F64x1& a, const F64x1& b) { return { a.v < b.v ? a.v : b.v }; }
+    friend F64x1 Max(const F64x1& a, const F64x1& b) { return { a.v > b.v ? a.v : b.v }; }
+    friend Mask operator>(const F64x1& a, const F64x1& b) { return a.v > b.v; }
+    friend Mask operator==(const F64x1& a, const F64x1& b) { return a.v == b.v; }
+    friend Mask BitsClear(const F64x1& a, const F64x1& b) { return (DoubleToBits(a.v) & DoubleToBits(b.v)) == 0; }
+    friend F64x1 Select(Mask m, const F64x1& a, const F64x1& b) { return m ? a : b; }
+    static bool Any(Mask m) { return m; }
+};
+
+#ifdef CURVE3D_X86
+struct F64x2 {
+    static const size_t Lanes = 2;
+    typedef double Scalar;
+    typedef __m128d Mask;
+    __m128d v;
+
+    CURVE3D_TARGET("sse2") static F64x2 Set(double x) { return { _mm_set1_pd(x) }; }
+    CURVE3D_TARGET("sse2") static F64x2 Load(const double* p) { return { _mm_loadu_pd(p) }; }
+    CURVE3D_TARGET("sse2") void Store(double* p) const { _mm_storeu_pd(p, v); }
+
+    CURVE3D_TARGET("sse2") friend F64x2 operator+(const F64x2& a, const F64x2& b) { return { _mm_add_pd(a.v, b.v) }; }
+    CURVE3D_TARGET("sse2") friend F64x2 operator-(const F64x2& a, const F64x2& b) { return { _mm_sub_pd(a.v, b.v) }; }
+    CURVE3D_TARGET("sse2") friend F64x2 operator*(const F64x2& a, const F64x2& b) { return { _mm_mul_pd(a.v, b.v) }; }
+    CURVE3D_TARGET("sse2") friend F64x2 operator^(const F64x2& a, const F64x2& b) { return { _mm_xor_pd(a.v, b.v) }; }
+    CURVE3D_TARGET("sse2") friend F64x2 MulAdd(const F64x2& a, const F64x2& b, const F64x2& c) { return { _mm_add_pd(_mm_mul_pd(a.v, b.v), c.v) }; }
+    CURVE3D_TARGET("sse2") friend F64x2 Abs(const F64x2& a) { return { _mm_andnot_pd(_mm_set1_pd(-0.0), a.v) }; }
+    CURVE3D_TARGET("sse2") friend F64x2 Min(const F64x2& a, const F64x2& b) { return { _mm_min_pd(a.v, b.v) }; }
+    CURVE3D_TARGET("sse2") friend F64x2 Max(const F64x2& a, const F64x2& b) { return { _mm_max_pd(a.v, b.v) }; }
+    CURVE3D_TARGET("sse2") friend Mask operator>(const F64x2& a, const F64x2& b) { return _mm_cmpgt_pd(a.v, b.v); }
+    CURVE3D_TARGET("sse2") friend Mask operator==(const F64x2& a, const F64x2& b) { return _mm_cmpeq_pd(a.v, b.v); }
+    CURVE3D_TARGET("sse2") friend Mask BitsClear(const F64x2& a, const F64x2& b) {
+        // Only the low dword of each lane is ever tested; broadcast its result over the lane.
+        __m128i x = _mm_and_si128(_mm_castpd_si128(a.v), _mm_castpd_si128(b.v));
+        __m128i m = _mm_cmpeq_epi32(x, _mm_setzero_si128());
+        return _mm_castsi128_pd(_mm_shuffle_epi32(m, _MM_SHUFFLE(2, 2, 0, 0)));
+    }
+    CURVE3D_TARGET("sse2") friend F64x2 Select(const Mask& m, const F64x2& a, const F64x2& b) { return { _mm_or_pd(_mm_and_pd(m, a.v), _mm_andnot_pd(m, b.v)) }; }
+    CURVE3D_TARGET("sse2") static bool Any(const Mask& m) { return _mm_movemask_pd(m) != 0; }
+};
+
+struct F64x4 {
+    static const size_t Lanes = 4;
+    typedef double Scalar;
+    typedef __m256d Mask;
+    __m256d v;
+
+    CURVE3D_TARGET("avx2,fma") static F64x4 Set(double x) { return { _mm256_set1_pd(x) }; }
+    CURVE3D_TARGET("avx2,fma") static F64x4 Load(const double* p) { return { _mm256_loadu_pd(p) }; }
+    CURVE3D_TARGET("avx2,fma") void Store(double* p) const { _mm256_storeu_pd(p, v); }
+
+    CURVE3D_TARGET("avx2,fma") friend F64x4 operator+(const F64x4& a, const F64x4& b) { return { _mm256_add_pd(a.v, b.v) }; }
+    CURVE3D_TARGET("avx2,fma") friend F64x4 operator-(const F64x4& a, const F64x4& b) { return { _mm256_sub_pd(a.v, b.v) }; }
+    CURVE3D_TARGET("avx2,fma") friend F64x4 operator*(const F64x4& a, const F64x4& b) { return { _mm256_mul_pd(a.v, b.v) }; }
+    CURVE3D_TARGET("avx2,fma") friend F64x4 operator^(const F64x4& a, const F64x4& b) { return { _mm256_xor_pd(a.v, b.v) }; }
+    CURVE3D_TARGET("avx2,fma") friend F64x4 MulAdd(const F64x4& a, const F64x4& b, const F64x4& c) { return { _mm256_fmadd_pd(a.v, b.v, c.v) }; }
+    CURVE3D_TARGET("avx2,fma") friend F64x4 Abs(const F64x4& a) { return { _mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v) }; }
+    CURVE3D_TARGET("avx2,fma") friend F64x4 Min(const F64x4& a, const F64x4& b) { return { _mm256_min_pd(a.v, b.v) }; }
+    CURVE3D_TARGET("avx2,fma") friend F64x4 Max(const F64x4& a, const F64x4& b) { return { _mm256_max_pd(a.v, b.v) }; }
+    CURVE3D_TARGET("avx2,fma") friend Mask operator>(const F64x4& a, const F64x4& b) { return _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ); }
+    CURVE3D_TARGET("avx2,fma") friend Mask operator==(const F64x4& a, const F64x4& b) { return _mm256_cmp_pd(a.v, b.v, _CMP_EQ_OQ); }
+    CURVE3D_TARGET("avx2,fma") friend Mask BitsClear(const F64x4& a, const F64x4& b) {
+        __m256i x = _mm256_and_si256(_mm256_castpd_si256(a.v), _mm256_castpd_si256(b.v));
+        return _mm256_castsi256_pd(_mm256_cmpeq_epi64(x, _mm256_setzero_si256()));
+    }
+    CURVE3D_TARGET("avx2,fma") friend F64x4 Select(const Mask& m, const F64x4& a, const F64x4& b) { return { _mm256_blendv_pd(b.v, a.v, m) }; }
+    CURVE3D_TARGET("avx2,fma") static bool Any(const Mask& m) { return _mm256_movemask_pd(m) != 0; }
+};
+
+struct F64x8 {
+    static const size_t Lanes = 8;
+    typedef double Scalar;
+    typedef __mmask8 Mask;
+    __m512d v;
+
+    CURVE3D_TARGET("avx512f") static F64x8 Set(double x) { return { _mm512_set1_pd(x) }; }
+    CURVE3D_TARGET("avx512f") static F64x8 Load(const double* p) { return { _mm512_loadu_pd(p) }; }
+    CURVE3D_TARGET("avx512f") void Store(double* p) const { _mm512_storeu_pd(p, v); }
+
+    CURVE3D_TARGET("avx512f") friend F64x8 operator+(const F64x8& a, const F64x8& b) { return { _mm512_add_pd(a.v, b.v) }; }
+    CURVE3D_TARGET("avx512f") friend F64x8 operator-(const F64x8& a, const F64x8& b) { return { _mm512_sub_pd(a.v, b.v) }; }
+    CURVE3D_TARGET("avx512f") friend F64x8 operator*(const F64x8& a, const F64x8& b) { return { _mm512_mul_pd(a.v, b.v) }; }
+    CURVE3D_TARGET("avx512f") friend F64x8 operator^(const F64x8& a, const F64x8& b) { return { _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(a.v), _mm512_castpd_si512(b.v))) }; }
+    CURVE3D_TARGET("avx512f") friend F64x8 MulAdd(const F64x8& a, const F64x8& b, const F64x8& c) { return { _mm512_fmadd_pd(a.v, b.v, c.v) }; }
+    CURVE3D_TARGET("avx512f") friend F64x8 Abs(const F64x8& a) { return { _mm512_abs_pd(a.v) }; }
+    // Full-mask forms: the unmasked ones pass _mm512_undefined_pd, which GCC 12
+    // reports as maybe-uninitialized once inlined.
+    CURVE3D_TARGET("avx512f") friend F64x8 Min(const F64x8& a, const F64x8& b) { return { _mm512_mask_min_pd(a.v, 0xFF, a.v, b.v) }; }
+    CURVE3D_TARGET("avx512f") friend F64x8 Max(const F64x8& a, const F64x8& b) { return { _mm512_mask_max_pd(a.v, 0xFF, a.v, b.v) }; }
+    CURVE3D_TARGET("avx512f") friend Mask operator>(const F64x8& a, const F64x8& b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_GT_OQ); }
+    CURVE3D_TARGET("avx512f") friend Mask operator==(const F64x8& a, const F64x8& b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_EQ_OQ); }
+    CURVE3D_TARGET("avx512f") friend Mask BitsClear(const F64x8& a, const F64x8& b) { return _mm512_testn_epi64_mask(_mm512_castpd_si512(a.v), _mm512_castpd_si512(b.v)); }
+    CURVE3D_TARGET("avx512f") friend F64x8 Select(Mask m, const F64x8& a, const F64x8& b) { return { _mm512_mask_blend_pd(m, b.v, a.v) }; }
+    CURVE3D_TARGET("avx512f") static bool Any(Mask m) { return m != 0; }
+};
+#endif
+
+// The same interface over floats, twice the lanes per register.
+struct F32x1 {
+    static const size_t Lanes = 1;
+    typedef float Scalar;
+    typedef bool Mask;
+    float v;
+
+    static F32x1 Set(float x) { return { x }; }
+    static F32x1 Load(const float* p) { return { *p }; }
+    void Store(float* p) const { *p = v; }
+
+    friend F32x1 operator+(const F32x1& a, const F32x1& b) { return { a.v + b.v }; }
+    friend F32x1 operator-(const F32x1& a, const F32x1& b) { return { a.v - b.v }; }
+    friend F32x1 operator*(const F32x1& a, const F32x1& b) { return { a.v * b.v }; }
+    friend F32x1 operator^(const F32x1& a, const F32x1& b) { return { BitsToFloat(FloatToBits(a.v) ^ FloatToBits(b.v)) }; }
+    friend F32x1 MulAdd(const F32x1& a, const F32x1& b, const F32x1& c) { return { a.v * b.v + c.v }; }
+    friend F32x1 Abs(const F32x1& a) { return { std::fabs(a.v) }; }
+    // Same operand rule as minps/maxps, as for F64x1.
+    friend F32x1 Min(const F32x1& a, const F32x1& b) { return { a.v < b.v ? a.v : b.v }; }
+    friend F32x1 Max(const F32x1& a, const F32x1& b) { return { a.v > b.v ? a.v : b.v }; }
+    friend Mask operator>(const F32x1& a, const F32x1& b) { return a.v > b.v; }
+    friend Mask operator==(const F32x1& a, const F32x1& b) { return a.v == b.v; }
+    friend Mask BitsClear(const F32x1& a, const F32x1& b) { return (FloatToBits(a.v) & FloatToBits(b.v)) == 0; }
+    friend F32x1 Select(Mask m, const F32x1& a, const F32x1& b) { return m ? a : b; }
+    static bool Any(Mask m) { return m; }
+};
+
+#ifdef CURVE3D_X86
+struct F32x4 {
+    static const size_t Lanes = 4;
+    typedef float Scalar;
+    typedef __m128 Mask;
+    __m128 v;
+
+    CURVE3D_TARGET("sse2") static F32x4 Set(float x) { return { _mm_set1_ps(x) }; }
+    CURVE3D_TARGET("sse2") static F32x4 Load(const float* p) { return { _mm_loadu_ps(p) }; }
+    CURVE3D_TARGET("sse2") void Store(float* p) const { _mm_storeu_ps(p, v); }
+
+    CURVE3D_TARGET("sse2") friend F32x4 operator+(const F32x4& a, const F32x4& b) { return { _mm_add_ps(a.v, b.v) }; }
+    CURVE3D_TARGET("sse2") friend F32x4 operator-(const F32x4& a, const F32x4& b) { return { _mm_sub_ps(a.v, b.v) }; }
+    CURVE3D_TARGET("sse2") friend F32x4 operator*(const F32x4& a, const F32x4& b) { return { _mm_mul_ps(a.v, b.v) }; }
+    CURVE3D_TARGET("sse2") friend F32x4 operator^(const F32x4& a, const F32x4& b) { return { _mm_xor_ps(a.v, b.v) }; }
+    CURVE3D_TARGET("sse2") friend F32x4 MulAdd(const F32x4& a, const F32x4& b, const F32x4& c) { return { _mm_add_ps(_mm_mul_ps(a.v, b.v), c.v) }; }
+    CURVE3D_TARGET("sse2") friend F32x4 Abs(const F32x4& a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+    CURVE3D_TARGET("sse2") friend F32x4 Min(const F32x4& a, const F32x4& b) { return { _mm_min_ps(a.v, b.v) }; }
+    CURVE3D_TARGET("sse2") friend F32x4 Max(const F32x4& a, const F32x4& b) { return { _mm_max_ps(a.v, b.v) }; }
+    CURVE3D_TARGET("sse2") friend Mask operator>(const F32x4& a, const F32x4& b) { return _mm_cmpgt_ps(a.v, b.v); }
+    CURVE3D_TARGET("sse2") friend Mask operator==(const F32x4& a, const F32x4& b) { return _mm_cmpeq_ps(a.v, b.v); }
+    CURVE3D_TARGET("sse2") friend Mask BitsClear(const F32x4& a, const F32x4& b) {
+        __m128i x = _mm_and_si128(_mm_castps_si128(a.v), _mm_castps_si128(b.v));
+        return _mm_castsi128_ps(_mm_cmpeq_epi32(x, _mm_setzero_si128()));
+    }
+    CURVE3D_TARGET("sse2") friend F32x4 Select(const Mask& m, const F32x4& a, const F32x4& b) { return { _mm_or_ps(_mm_and_ps(m, a.v), _mm_andnot_ps(m, b.v)) }; }
+    CURVE3D_TARGET("sse2") static bool Any(const Mask& m) { return _mm_movemask_ps(m) != 0; }
+};
+
+struct F32x8 {
+    static const size_t Lanes = 8;
+    typedef float Scalar;
+    typedef __m256 Mask;
+    __m256 v;
+
+    CURVE3D_TARGET("avx2,fma") static F32x8 Set(float x) { return { _mm256_set1_ps(x) }; }
+    CURVE3D_TARGET("avx2,fma") static F32x8 Load(const float* p) { return { _mm256_loadu_ps(p) }; }
+    CURVE3D_TARGET("avx2,fma") void Store(float* p) const { _mm256_storeu_ps(p, v); }
+
+    CURVE3D_TARGET("avx2,fma") friend F32x8 operator+(const F32x8& a, const F32x8& b) { return { _mm256_add_ps(a.v, b.v) }; }
+    CURVE3D_TARGET("avx2,fma") friend F32x8 operator-(const F32x8& a, const F32x8& b) { return { _mm256_sub_ps(a.v, b.v) }; }
+    CURVE3D_TARGET("avx2,fma") friend F32x8 operator*(const F32x8& a, const F32x8& b) { return { _mm256_mul_ps(a.v, b.v) }; }
+    CURVE3D_TARGET("avx2,fma") friend F32x8 operator^(const F32x8& a, const F32x8& b) { return { _mm256_xor_ps(a.v, b.v) }; }
+    CURVE3D_TARGET("avx2,fma") friend F32x8 MulAdd(const F32x8& a, const F32x8& b, const F32x8& c) { return { _mm256_fmadd_ps(a.v, b.v, c.v) }; }
+    CURVE3D_TARGET("avx2,fma") friend F32x8 Abs(const F32x8& a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+    CURVE3D_TARGET("avx2,fma") friend F32x8 Min(const F32x8& a, const F32x8& b) { return { _mm256_min_ps(a.v, b.v) }; }
+    CURVE3D_TARGET("avx2,fma") friend F32x8 Max(const F32x8& a, const F32x8& b) { return { _mm256_max_ps(a.v, b.v) }; }
+    CURVE3D_TARGET("avx2,fma") friend Mask operator>(const F32x8& a, const F32x8& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+    CURVE3D_TARGET("avx2,fma") friend Mask operator==(const F32x8& a, const F32x8& b) { return _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ); }
+    CURVE3D_TARGET("avx2,fma") friend Mask BitsClear(const F32x8& a, const F32x8& b) {
+        __m256i x = _mm256_and_si256(_mm256_castps_si256(a.v), _mm256_castps_si256(b.v));
+        return _mm256_castsi256_ps(_mm256_cmpeq_epi32(x, _mm256_setzero_si256()));
+    }
+    CURVE3D_TARGET("avx2,fma") friend F32x8 Select(const Mask& m, const F32x8& a, const F32x8& b) { return { _mm256_blendv_ps(b.v, a.v, m) }; }
+    CURVE3D_TARGET("avx2,fma") static bool Any(const Mask& m) { return _mm256_movemask_ps(m) != 0; }
+};
+
+struct F32x16 {
+    static const size_t Lanes = 16;
+    typedef float Scalar;
+    typedef __mmask16 Mask;
+    __m512 v;
+
+    CURVE3D_TARGET("avx512f") static F32x16 Set(float x) { return { _mm512_set1_ps(x) }; }
+    CURVE3D_TARGET("avx512f") static F32x16 Load(const float* p) { return { _mm512_loadu_ps(p) }; }
+    CURVE3D_TARGET("avx512f") void Store(float* p) const { _mm512_storeu_ps(p, v); }
+
+    CURVE3D_TARGET("avx512f") friend F32x16 operator+(const F32x16& a, const F32x16& b) { return { _mm512_add_ps(a.v, b.v) }; }
+    CURVE3D_TARGET("avx512f") friend F32x16 operator-(const F32x16& a, const F32x16& b) { return { _mm512_sub_ps(a.v, b.v) }; }
+    CURVE3D_TARGET("avx512f") friend F32x16 operator*(const F32x16& a, const F32x16& b) { return { _mm512_mul_ps(a.v, b.v) }; }
+    CURVE3D_TARGET("avx512f") friend F32x16 operator^(const F32x16& a, const F32x16& b) { return { _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a.v), _mm512_castps_si512(b.v))) }; }
+    CURVE3D_TARGET("avx512f") friend F32x16 MulAdd(const F32x16& a, const F32x16& b, const F32x16& c) { return { _mm512_fmadd_ps(a.v, b.v, c.v) }; }
+    CURVE3D_TARGET("avx512f") friend F32x16 Abs(const F32x16& a) { return { _mm512_abs_ps(a.v) }; }
+    // Full-mask forms, as for F64x8.
+    CURVE3D_TARGET("avx512f") friend F32x16 Min(const F32x16& a, const F32x16& b) { return { _mm512_mask_min_ps(a.v, 0xFFFF, a.v, b.v) }; }
+    CURVE3D_TARGET("avx512f") friend F32x16 Max(const F32x16& a, const F32x16& b) { return { _mm512_mask_max_ps(a.v, 0xFFFF, a.v, b.v) }; }
+    CURVE3D_TARGET("avx512f") friend Mask operator>(const F32x16& a, const F32x16& b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ); }
+    CURVE3D_TARGET("avx512f") friend Mask operator==(const F32x16& a, const F32x16& b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_EQ_OQ); }
+    CURVE3D_TARGET("avx512f") friend Mask BitsClear(const F32x16& a, const F32x16& b) { return _mm512_testn_epi32_mask(_mm512_castps_si512(a.v), _mm512_castps_si512(b.v)); }
+    CURVE3D_TARGET("avx512f") friend F32x16 Select(Mask m, const F32x16& a, const F32x16& b) { return { _mm512_mask_blend_ps(m, b.v, a.v) }; }
+    CURVE3D_TARGET("avx512f") static bool Any(Mask m) { return m != 0; }
+};
+#endif
+
+// The kernel templates below have no target attribute of their own; they only
+// run inlined into the CURVE3D_TARGET wrappers further down, so the by-value
+// AVX packs they pass never cross an ABI boundary. GCC still flags each
+// instantiation with -Wpsabi, hence the local suppression.
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+// Polynomial sin/cos over a pack: Cody-Waite reduction by pi/2 with a three-part
+// constant, then the fdlibm minimax kernels on [-pi/4, pi/4]. Measured against a
+// long double reference (--check): at most 1.1 ulp for |t| <= 1, 1.6 ulp for
+// |t| <= 1e3 and 2.4 ulp up to SinCosLimit, never more than 1.6e-16 absolute
+// (std::sin/std::cos: 5.6e-17); the FMA and non-FMA packs stay within the same
+// bounds.
+// Larger arguments, infinities included, go through std::sin/std::cos.
+const double SinCosLimit = 1.0e6;
+
+template <class V>
+CURVE3D_INLINE void SinCosPack(const V& t, V& s, V& c, double) {
+    const V magic = V::Set(6755399441055744.0);
+    V y = MulAdd(t, V::Set(2 / PI), magic);
+    V n = y - magic;
+
+    V r = MulAdd(n, V::Set(-1.57079632673412561417e+00), t);
+    r = MulAdd(n, V::Set(-6.07710050630396597660e-11), r);
+    r = MulAdd(n, V::Set(-2.02226624871116645580e-21), r);
+
+    V z = r * r;
+    V ps = MulAdd(z, V::Set(1.58969099521155010221e-10), V::Set(-2.50507602534068634195e-08));
+    ps = MulAdd(z, ps, V::Set(2.75573137070700676789e-06));
+    ps = MulAdd(z, ps, V::Set(-1.98412698298579493134e-04));
+    ps = MulAdd(z, ps, V::Set(8.33333333332248946124e-03));
+    ps = MulAdd(z, ps, V::Set(-1.66666666666666324348e-01));
+    V sr = MulAdd(r * z, ps, r);
+
+    V pc = MulAdd(z, V::Set(-1.13596475577881948265e-11), V::Set(2.08757232129817482790e-09));
+    pc = MulAdd(z, pc, V::Set(-2.75573143513906633035e-07));
+    pc = MulAdd(z, pc, V::Set(2.48015872894767294178e-05));
+    pc = MulAdd(z, pc, V::Set(-1.38888888888741095749e-03));
+    pc = MulAdd(z, pc, V::Set(4.16666666666666019037e-02));
+    V one = V::Set(1.0);
+    V hz = V::Set(0.5) * z;
+    V w = one - hz;
+    V cr = w + (((one - w) - hz) + (z * z) * pc);
+
+    // The low mantissa bits of y hold n mod 4, the quadrant of t.
+    V signBit = V::Set(-0.0);
+    V zero = V::Set(0.0);
+    typename V::Mask even = BitsClear(y, V::Set(BitsToDouble(1)));
+    V sinSign = Select(BitsClear(y, V::Set(BitsToDouble(2))), zero, signBit);
+    V cosSign = Select(BitsClear(y + one, V::Set(BitsToDouble(2))), zero, signBit);
+    s = Select(even, sr, cr) ^ sinSign;
+    c = Select(even, cr, sr) ^ cosSign;
+}
+
+// Single-precision variant: the same reduction with the Cephes sinf split of
+// pi/2, exact in the first two products up to SinCosFloatLimit, and the
+// Cephes minimax polynomials. Measured against double sin/cos (--check), with
+// or without FMA: at most 1.5 ulp for |t| <= 1 and never more than 9.4e-8
+// absolute up to the limit. Near the zeros of larger arguments the float
+// reduction leaves that absolute error, so relative error there grows to
+// hundreds of ulp.
+const float SinCosFloatLimit = 8192.0f;
+
+template <class V>
+CURVE3D_INLINE void SinCosPack(const V& t, V& s, V& c, float) {
+    const V magic = V::Set(12582912.0f);
+    V y = MulAdd(t, V::Set(float(2 / PI)), magic);
+    V n = y - magic;
+
+    V r = MulAdd(n, V::Set(-1.5703125f), t);
+    r = MulAdd(n, V::Set(-4.837512969970703125e-4f), r);
+    r = MulAdd(n, V::Set(-7.54978995489188216e-8f), r);
+
+    V z = r * r;
+    V ps = MulAdd(z, V::Set(-1.9515295891e-4f), V::Set(8.3321608736e-3f));
+    ps = MulAdd(z, ps, V::Set(-1.6666654611e-1f));
+    V sr = MulAdd(r * z, ps, r);
+
+    V pc = MulAdd(z, V::Set(2.443315711809948e-5f), V::Set(-1.388731625493765e-3f));
+    pc = MulAdd(z, pc, V::Set(4.166664568298827e-2f));
+    V one = V::Set(1.0f);
+    V cr = MulAdd(z * z, pc, MulAdd(z, V::Set(-0.5f), one));
+
+    V signBit = V::Set(-0.0f);
+    V zero = V::Set(0.0f);
+    typename V::Mask even = BitsClear(y, V::Set(BitsToFloat(1)));
+    V sinSign = Select(BitsClear(y, V::Set(BitsToFloat(2))), zero, signBit);
+    V cosSign = Select(BitsClear(y + one, V::Set(BitsToFloat(2))), zero, signBit);
+    s = Select(even, sr, cr) ^ sinSign;
+    c = Select(even, cr, sr) ^ cosSign;
+}
+
+template <class V>
+CURVE3D_INLINE void SinCosLanes(const typename V::Scalar* ts, typename V::Scalar* s, typename V::Scalar* c) {
+    typedef typename V::Scalar Real;
+    Real limit = sizeof(Real) == sizeof(float) ? Real(SinCosFloatLimit) : Real(SinCosLimit);
+    V t = V::Load(ts);
+    if (V::Any(Abs(t) > V::Set(limit))) {
+        for (size_t k = 0; k < V::Lanes; k++) {
+            s[k] = std::sin(ts[k]);
+            c[k] = std::cos(ts[k]);
+        }
+        return;
+    }
+    V vs, vc;
+    SinCosPack(t, vs, vc, Real());
+    vs.Store(s);
+    vc.Store(c);
+}
+
+template <class V>
+CURVE3D_INLINE void SinCosKernel(const typename V::Scalar* ts, typename V::Scalar* s, typename V::Scalar* c, size_t count) {
+    typedef typename std::conditional<sizeof(typename V::Scalar) == sizeof(float), F32x1, F64x1>::type Tail;
+    size_t i = 0;
+    for (; i + V::Lanes <= count; i += V::Lanes) {
+        SinCosLanes<V>(ts + i, s + i, c + i);
+    }
+    for (; i < count; i++) {
+        SinCosLanes<Tail>(ts + i, s + i, c + i);
+    }
+}
+
+// Eight interleaved partial sums whatever the pack width, folded pairwise at
+// the end, so every ISA adds in the same order and returns the same bits.
+template <class V>
+CURVE3D_INLINE double SumKernel(const double* values, size_t count) {
+    const size_t Packs = 8 / V::Lanes;
+    V acc[Packs];
+    for (size_t p = 0; p < Packs; p++) {
+        acc[p] = V::Set(0.0);
+    }
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        for (size_t p = 0; p < Packs; p++) {
+            acc[p] = acc[p] + V::Load(values + i + p * V::Lanes);
+        }
+    }
+    double lanes[8];
+    for (size_t p = 0; p < Packs; p++) {
+        acc[p].Store(lanes + p * V::Lanes);
+    }
+    for (size_t k = 0; i < count; i++, k++) {
+        lanes[k] += values[i];
+    }
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+struct CompensatedSum {
+    double sum;
+    double compensation;
+
+    double Value() const { return sum + compensation; }
+};
+
+inline void NeumaierAdd(CompensatedSum& acc, double x) {
+    double t = acc.sum + x;
+    acc.compensation += fabs(acc.sum) > fabs(x) ? (acc.sum - t) + x : (x - t) + acc.sum;
+    acc.sum = t;
+}
+
+// Neumaier compensated summation in the same fixed eight-lane shape as
+// SumKernel: each lane carries its own running error term, and the lanes are
+// folded in a fixed order, so results are again identical across ISAs.
+template <class V>
+CURVE3D_INLINE CompensatedSum CompensatedSumKernel(const double* values, size_t count) {
+    const size_t Packs = 8 / V::Lanes;
+    V sums[Packs];
+    V errors[Packs];
+    for (size_t p = 0; p < Packs; p++) {
+        sums[p] = V::Set(0.0);
+        errors[p] = V::Set(0.0);
+    }
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        for (size_t p = 0; p < Packs; p++) {
+            V x = V::Load(values + i + p * V::Lanes);
+            V t = sums[p] + x;
+            errors[p] = errors[p] + Select(Abs(sums[p]) > Abs(x), (sums[p] - t) + x, (x - t) + sums[p]);
+            sums[p] = t;
+        }
+    }
+    double laneSums[8];
+    double laneErrors[8];
+    for (size_t p = 0; p < Packs; p++) {
+        sums[p].Store(laneSums + p * V::Lanes);
+        errors[p].Store(laneErrors + p * V::Lanes);
+    }
+
+    CompensatedSum result = { 0.0, 0.0 };
+    for (size_t k = 0; i < count; i++, k++) {
+        CompensatedSum lane = { laneSums[k], laneErrors[k] };
+        NeumaierAdd(lane, values[i]);
+        laneSums[k] = lane.sum;
+        laneErrors[k] = lane.compensation;
+    }
+    for (size_t k = 0; k < 8; k++) {
+        NeumaierAdd(result, laneSums[k]);
+        result.compensation += laneErrors[k];
+    }
+    return result;
+}
+
+struct Moments {
+    size_t count;
+    double sum;
+    double sumSquares;
+    double min;
+    double max;
+};
+
+// Count, sum and sum of squares of (x - shift), plus min and max, of the
+// non-NaN values in one pass; NaN lanes are masked out of every accumulator,
+// so all ISAs agree. A shift close to the mean keeps the variance computed
+// from them accurate.
+template <class V>
+CURVE3D_INLINE Moments MomentsKernel(const double* values, size_t count, double shift) {
+    const V zero = V::Set(0.0);
+    const V one = V::Set(1.0);
+    const V inf = V::Set(INFINITY);
+    V center = V::Set(shift);
+    V ordered = zero;
+    V sum = zero;
+    V squares = zero;
+    V lo = inf;
+    V hi = zero - inf;
+    size_t i = 0;
+    for (; i + V::Lanes <= count; i += V::Lanes) {
+        V x = V::Load(values + i);
+        typename V::Mask number = x == x;
+        V d = Select(number, x - center, zero);
+        ordered = ordered + Select(number, one, zero);
+        sum = sum + d;
+        squares = MulAdd(d, d, squares);
+        lo = Min(lo, Select(number, x, inf));
+        hi = Max(hi, Select(number, x, zero - inf));
+    }
+
+    double lanes[5][V::Lanes];
+    ordered.Store(lanes[0]);
+    sum.Store(lanes[1]);
+    squares.Store(lanes[2]);
+    lo.Store(lanes[3]);
+    hi.Store(lanes[4]);
+    Moments result = { 0, 0.0, 0.0, INFINITY, -INFINITY };
+    for (size_t k = 0; k < V::Lanes; k++) {
+        result.count += static_cast<size_t>(lanes[0][k]);
+        result.sum += lanes[1][k];
+        result.sumSquares += lanes[2][k];
+        result.min = std::min(result.min, lanes[3][k]);
+        result.max = std::max(result.max, lanes[4][k]);
+    }
+    for (; i < count; i++) {
+        if (std::isnan(values[i])) {
+            continue;
+        }
+        result.count++;
+        double d = values[i] - shift;
+        result.sum += d;
+        result.sumSquares += d * d;
+        result.min = std::min(result.min, values[i]);
+        result.max = std::max(result.max, values[i]);
+    }
+    return result;
+}
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+inline void SinCosScalar(const double* ts, double* s, double* c, size_t count) {
+    SinCosKernel<F64x1>(ts, s, c, count);
+}
+
+inline void SinCosFloatScalar(const float* ts, float* s, float* c, size_t count) {
+    SinCosKernel<F32x1>(ts, s, c, count);
+}
+
+inline double SumScalar(const double* values, size_t count) {
+    return SumKernel<F64x1>(values, count);
+}
+
+inline CompensatedSum CompensatedSumScalar(const double* values, size_t count) {
+    return CompensatedSumKernel<F64x1>(values, count);
+}
+
+inline Moments MomentsScalar(const double* values, size_t count, double shift) {
+    return MomentsKernel<F64x1>(values, count, shift);
+}
+
+#ifdef CURVE3D_X86
+CURVE3D_TARGET("sse2") CURVE3D_FLATTEN inline void SinCosSse2(const double* ts, double* s, double* c, size_t count) {
+    SinCosKernel<F64x2>(ts, s, c, count);
+}
+
+CURVE3D_TARGET("sse2") CURVE3D_FLATTEN inline void SinCosFloatSse2(const float* ts, float* s, float* c, size_t count) {
+    SinCosKernel<F32x4>(ts, s, c, count);
+}
+
+CURVE3D_TARGET("sse2") CURVE3D_FLATTEN inline double SumSse2(const double* values, size_t count) {
+    return SumKernel<F64x2>(values, count);
+}
+
+CURVE3D_TARGET("sse2") CURVE3D_FLATTEN inline CompensatedSum CompensatedSumSse2(const double* values, size_t count) {
+    return CompensatedSumKernel<F64x2>(values, count);
+}
+
+CURVE3D_TARGET("sse2") CURVE3D_FLATTEN inline Moments MomentsSse2(const double* values, size_t count, double shift) {
+    return MomentsKernel<F64x2>(values, count, shift);
+}
+
+CURVE3D_TARGET("avx2,fma") CURVE3D_FLATTEN inline void SinCosAvx2(const double* ts, double* s, double* c, size_t count) {
+    SinCosKernel<F64x4>(ts, s, c, count);
+}
+
+CURVE3D_TARGET("avx2,fma") CURVE3D_FLATTEN inline void SinCosFloatAvx2(const float* ts, float* s, float* c, size_t count) {
+    SinCosKernel<F32x8>(ts, s, c, count);
+}
+
+CURVE3D_TARGET("avx2,fma") CURVE3D_FLATTEN inline double SumAvx2(const double* values, size_t count) {
+    return SumKernel<F64x4>(values, count);
+}
+
+CURVE3D_TARGET("avx2,fma") CURVE3D_FLATTEN inline CompensatedSum CompensatedSumAvx2(const double* values, size_t count) {
+    return CompensatedSumKernel<F64x4>(values, count);
+}
+
+CURVE3D_TARGET("avx2,fma") CURVE3D_FLATTEN inline Moments MomentsAvx2(const double* values, size_t count, double shift) {
+    return MomentsKernel<F64x4>(values, count, shift);
+}
+
+CURVE3D_TARGET("avx512f") CURVE3D_FLATTEN inline void SinCosAvx512(const double* ts, double* s, double* c, size_t count) {
+    SinCosKernel<F64x8>(ts, s, c, count);
+}
+
+CURVE3D_TARGET("avx512f") CURVE3D_FLATTEN inline void SinCosFloatAvx512(const float* ts, float* s, float* c, size_t count) {
+    SinCosKernel<F32x16>(ts, s, c, count);
+}
+
+CURVE3D_TARGET("avx512f") CURVE3D_FLATTEN inline double SumAvx512(const double* values, size_t count) {
+    return SumKernel<F64x8>(values, count);
+}
+
+CURVE3D_TARGET("avx512f") CURVE3D_FLATTEN inline CompensatedSum CompensatedSumAvx512(const double* values, size_t count) {
+    return CompensatedSumKernel<F64x8>(values, count);
+}
+
+CURVE3D_TARGET("avx512f") CURVE3D_FLATTEN inline Moments MomentsAvx512(const double* values, size_t count, double shift) {
+    return MomentsKernel<F64x8>(values, count, shift);
+}
+#endif
+
+enum class Isa { Scalar, Sse2, Avx2, Avx512 };
+
+inline const char* IsaName(Isa isa) {
+    switch (isa) {
+    case Isa::Sse2: return "sse2";
+    case Isa::Avx2: return "avx2";
+    case Isa::Avx512: return "avx512";
+    default: return "scalar";
+    }
+}
+
+inline std::string GetEnvironment(const char* name) {
+#ifdef _MSC_VER
+    char* value = nullptr;
+    size_t length = 0;
+    if (_dupenv_s(&value, &length, name) != 0 || value == nullptr) {
+        return std::string();
+    }
+    std::string result(value);
+    free(value);
+    return result;
+#else
+    const char* value = getenv(name);
+    return value ? value : "";
+#endif
+}
+
+#ifdef CURVE3D_X86
+inline void CpuId(int leaf, int subleaf, unsigned int regs[4]) {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, leaf, subleaf);
+    for (int i = 0; i < 4; i++) {
+        regs[i] = static_cast<unsigned int>(info[i]);
+    }
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+inline uint64_t XGetBv() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+#endif
+}
+#endif
+
+// Widest ISA both the CPU and the OS (saved register state) support.
+inline Isa DetectIsa() {
+#ifdef CURVE3D_X86
+    unsigned int regs[4];
+    CpuId(0, 0, regs);
+    unsigned int maxLeaf = regs[0];
+    CpuId(1, 0, regs);
+    bool sse2 = (regs[3] & (1u << 26)) != 0;
+    bool fma = (regs[2] & (1u << 12)) != 0;
+    bool osxsave = (regs[2] & (1u << 27)) != 0;
+    bool avx = (regs[2] & (1u << 28)) != 0;
+    if (!sse2) {
+        return Isa::Scalar;
+    }
+    if (!osxsave || !avx || maxLeaf < 7) {
+        return Isa::Sse2;
+    }
+    uint64_t xcr0 = XGetBv();
+    CpuId(7, 0, regs);
+    bool avx2 = (regs[1] & (1u << 5)) != 0;
+    bool avx512f = (regs[1] & (1u << 16)) != 0;
+    if (avx512f && (xcr0 & 0xE6) == 0xE6) {
+        return Isa::Avx512;
+    }
+    if (avx2 && fma && (xcr0 & 0x06) == 0x06) {
+        return Isa::Avx2;
+    }
+    return Isa::Sse2;
+#else
+    return Isa::Scalar;
+#endif
+}
+
+// Batch kernels bound once for the running CPU. CURVE3D_ISA=scalar|sse2|avx2|avx512
+// (any case) forces a narrower set for testing; requests above what the CPU
+// supports are clamped, and both that and an unknown name are reported on stderr.
+struct CurveKernels {
+    Isa isa;
+    void (*sinCos)(const double* ts, double* s, double* c, size_t count);
+    void (*sinCosFloat)(const float* ts, float* s, float* c, size_t count);
+    double (*sum)(const double* values, size_t count);
+    CompensatedSum (*compensatedSum)(const double* values, size_t count);
+    Moments (*moments)(const double* values, size_t count, double shift);
+};
+
+// The kernels for one ISA, which the caller must know the CPU supports.
+inline CurveKernels KernelsFor(Isa isa) {
+    switch (isa) {
+#ifdef CURVE3D_X86
+    case Isa::Avx512: return { isa, SinCosAvx512, SinCosFloatAvx512, SumAvx512, CompensatedSumAvx512, MomentsAvx512 };
+    case Isa::Avx2: return { isa, SinCosAvx2, SinCosFloatAvx2, SumAvx2, CompensatedSumAvx2, MomentsAvx2 };
+    case Isa::Sse2: return { isa, SinCosSse2, SinCosFloatSse2, SumSse2, CompensatedSumSse2, MomentsSse2 };
+#endif
+    default: return { Isa::Scalar, SinCosScalar, SinCosFloatScalar, SumScalar, CompensatedSumScalar, MomentsScalar };
+    }
+}
+
+inline CurveKernels SelectKernels() {
+    Isa isa = DetectIsa();
+    std::string forced = GetEnvironment("CURVE3D_ISA");
+    if (forced.empty()) {
+        return KernelsFor(isa);
+    }
+
+    std::string name = forced;
+    for (char& ch : name) {
+        ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+    }
+    bool known = false;
+    for (Isa candidate : { Isa::Scalar, Isa::Sse2, Isa::Avx2, Isa::Avx512 }) {
+        if (name == IsaName(candidate)) {
+            known = true;
+            if (candidate < isa) {
+                isa = candidate;
+            } else if (candidate > isa) {
+                std::cerr << "CURVE3D_ISA=" << forced << " is not supported by this CPU; using " << IsaName(isa) << "\n";
+            }
+        }
+    }
+    if (!known) {
+        std::cerr << "CURVE3D_ISA=" << forced << " is not one of scalar, sse2, avx2, avx512; using " << IsaName(isa) << "\n";
+    }
+    return KernelsFor(isa);
+}
+
+inline const CurveKernels& Kernels() {
+    static const CurveKernels kernels = SelectKernels();
+    return kernels;
+}
+
+inline void SinCos(const double* ts, double* s, double* c, size_t count) {
+    Kernels().sinCos(ts, s, c, count);
+}
+
+inline void SinCos(const float* ts, float* s, float* c, size_t count) {
+    Kernels().sinCosFloat(ts, s, c, count);
+}
+
+inline size_t WorkerCount() {
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+// Helper threads kept for the life of the process, so a parallel call costs a
+// wake-up instead of creating and joining threads. The pool grows to the
+// largest helper count asked for. One job runs at a time: Run returns false
+// while another is in flight, including from inside a job's own work.
+class WorkerPool {
+private:
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::vector<std::thread> threads;
+    void (*run)(void*);
+    void* job;
+    uint64_t generation;
+    size_t wanted;
+    size_t active;
+    bool busy;
+    bool stopping;
+
+    template <class F>
+    static void Invoke(void* f) { (*static_cast<F*>(f))(); }
+
+    void Work() {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [&] { return stopping || (generation != seen && wanted > 0); });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+            wanted--;
+            active++;
+            void (*f)(void*) = run;
+            void* context = job;
+            lock.unlock();
+            f(context);
+            lock.lock();
+            if (--active == 0) {
+                idle.notify_all();
+            }
+        }
+    }
+
+public:
+    WorkerPool() : run(nullptr), job(nullptr), generation(0), wanted(0), active(0), busy(false), stopping(false) {}
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    // Runs work() on the calling thread and on up to `helpers` pool threads,
+    // returning once every copy has finished. work must be safe to run
+    // concurrently and to find nothing left to do.
+    template <class F>
+    bool Run(size_t helpers, F& work) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (busy) {
+                return false;
+            }
+            busy = true;
+            while (threads.size() < helpers) {
+                threads.emplace_back([this] { Work(); });
+            }
+            run = &Invoke<F>;
+            job = &work;
+            wanted = helpers;
+            generation++;
+        }
+        wake.notify_all();
+        work();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        wanted = 0;
+        idle.wait(lock, [&] { return active == 0; });
+        busy = false;
+        return true;
+    }
+};
+
+inline WorkerPool& Workers() {
+    static WorkerPool pool;
+    return pool;
+}
+
+// Runs f(task) for every task in [0, tasks), handed out dynamically to up to
+// `threads` threads, the calling thread included. Helpers come from Workers();
+// a call made while the pool is busy runs on the calling thread alone.
+template <class F>
+void ParallelFor(size_t tasks, size_t threads, F f) {
+    threads = std::min(threads, tasks);
+    std::atomic<size_t> next(0);
+    auto work = [&] {
+        for (size_t task = next++; task < tasks; task = next++) {
+            f(task);
+        }
+    };
+    if (threads <= 1 || !Workers().Run(threads - 1, work)) {
+        work();
+    }
+}
+
+enum class SumMode { Fast, Compensated };
+
+// Pairwise sum with a shape fixed by the count alone.
+inline double PairwiseSum(const double* values, size_t count) {
+    if (count <= 2) {
+        return count == 0 ? 0.0 : count == 1 ? values[0] : values[0] + values[1];
+    }
+    size_t half = count / 2;
+    return PairwiseSum(values, half) + PairwiseSum(values + half, count - half);
+}
+
+// Sums values in fixed blocks with the dispatched SIMD kernels, spread over
+// up to `threads` threads, then combines the block partials in a fixed order:
+// a pairwise tree for Fast, a compensated pass for Compensated. Block size and
+// combine shape do not depend on the thread count or ISA, so neither does the
+// result, bit for bit. The block partials come from scratch.
+inline double ReduceSum(const double* values, size_t count, SumMode mode = SumMode::Fast, size_t threads = WorkerCount(),
+    std::pmr::memory_resource* scratch = std::pmr::get_default_resource()) {
+    const size_t Block = 1 << 13;
+    const size_t ThreadedBlocks = 16;
+    size_t blocks = (count + Block - 1) / Block;
+    if (blocks < ThreadedBlocks) {
+        threads = 1;
+    }
+
+    std::pmr::vector<CompensatedSum> partials(blocks, scratch);
+    ParallelFor(blocks, threads, [&](size_t block) {
+        const double* begin = values + block * Block;
+        size_t length = std::min(Block, count - block * Block);
+        if (mode == SumMode::Compensated) {
+            partials[block] = Kernels().compensatedSum(begin, length);
+        } else {
+            partials[block] = { Kernels().sum(begin, length), 0.0 };
+        }
+    });
+
+    if (mode == SumMode::Compensated) {
+        CompensatedSum total = { 0.0, 0.0 };
+        for (const CompensatedSum& partial : partials) {
+            NeumaierAdd(total, partial.sum);
+            total.compensation += partial.compensation;
+        }
+        return total.Value();
+    }
+
+    std::pmr::vector<double> sums(blocks, scratch);
+    for (size_t block = 0; block < blocks; block++) {
+        sums[block] = partials[block].sum;
+    }
+    return PairwiseSum(sums.data(), blocks);
+}
+
+struct HistogramSpec {
+    double lo;
+    double hi;
+    size_t bins;
+    bool logarithmic;
+};
+
+// Statistics of one parameter column. The variance is the population
+// variance; values outside [lo, hi) of the histogram, and non-positive values
+// of a logarithmic one, land in underflow/overflow. NaNs are counted in
+// unordered and left out of count, the moments and every bin.
+struct ColumnSummary {
+    size_t count;
+    double mean;
+    double variance;
+    double min;
+    double max;
+    std::pmr::vector<size_t> bins;
+    size_t underflow;
+    size_t overflow;
+    size_t unordered;
+};
+
+// Mean, variance, min, max and a fixed-width or log-width histogram in a single
+// pass over the column. Each thread takes a contiguous share of blocks with its
+// own bins; the partial summaries are merged at the end, moments by Chan's
+// pairwise update. The partials and their bins come from scratch, the result's
+// bins from the default resource. Throws std::invalid_argument for a histogram
+// without bins, without a finite lo < hi, or logarithmic with lo <= 0.
+inline ColumnSummary SummarizeColumn(const std::vector<double>& values, const HistogramSpec& histogram, size_t threads = WorkerCount(),
+    std::pmr::memory_resource* scratch = std::pmr::get_default_resource()) {
+    if (histogram.bins == 0 || !std::isfinite(histogram.lo) || !std::isfinite(histogram.hi) || !(histogram.lo < histogram.hi) ||
+        (histogram.logarithmic && !(histogram.lo > 0.0))) {
+        throw std::invalid_argument("SummarizeColumn: degenerate histogram spec");
+    }
+    const size_t Block = 1 << 12;
+    size_t n = values.size();
+    size_t blocks = (n + Block - 1) / Block;
+    size_t tasks = std::max<size_t>(1, std::min(threads, blocks / 4));
+    double shift = 0.0;
+    for (double x : values) {
+        if (!std::isnan(x)) {
+            shift = x;
+            break;
+        }
+    }
+    double origin = histogram.logarithmic ? log(histogram.lo) : histogram.lo;
+    double extent = histogram.logarithmic ? log(histogram.hi) - origin : histogram.hi - origin;
+    double scale = histogram.bins / extent;
+    if (!std::isfinite(scale)) {
+        throw std::invalid_argument("SummarizeColumn: histogram range too narrow for its bins");
+    }
+
+    std::pmr::vector<ColumnSummary> partials(scratch);
+    partials.reserve(tasks);
+    for (size_t task = 0; task < tasks; task++) {
+        partials.push_back({ 0, 0.0, 0.0, INFINITY, -INFINITY, std::pmr::vector<size_t>(histogram.bins, 0, scratch), 0, 0, 0 });
+    }
+    ParallelFor(tasks, tasks, [&](size_t task) {
+        ColumnSummary& partial = partials[task];
+        double m2 = 0.0;
+        for (size_t block = task * blocks / tasks; block < (task + 1) * blocks / tasks; block++) {
+            const double* begin = values.data() + block * Block;
+            size_t length = std::min(Block, n - block * Block);
+            Moments moments = Kernels().moments(begin, length, shift);
+            if (moments.count != 0) {
+                double blockMean = moments.sum / moments.count;
+                double blockM2 = moments.sumSquares - moments.sum * blockMean;
+                blockMean += shift;
+
+                size_t total = partial.count + moments.count;
+                double delta = blockMean - partial.mean;
+                partial.mean += delta * moments.count / total;
+                m2 += blockM2 + delta * delta * partial.count * moments.count / total;
+                partial.count = total;
+                partial.min = std::min(partial.min, moments.min);
+                partial.max = std::max(partial.max, moments.max);
+            }
+
+            for (size_t i = 0; i < length; i++) {
+                double x = begin[i];
+                if (std::isnan(x)) {
+                    partial.unordered++;
+                    continue;
+                }
+                double position = ((histogram.logarithmic ? (x > 0.0 ? log(x) : -INFINITY) : x) - origin) * scale;
+                if (position < 0.0) {
+                    partial.underflow++;
+                } else if (position >= histogram.bins) {
+                    partial.overflow++;
+                } else {
+                    partial.bins[static_cast<size_t>(position)]++;
+                }
+            }
+        }
+        partial.variance = m2;
+    });
+
+    ColumnSummary summary = { 0, 0.0, 0.0, INFINITY, -INFINITY, std::pmr::vector<size_t>(histogram.bins, 0), 0, 0, 0 };
+    double m2 = 0.0;
+    for (const ColumnSummary& partial : partials) {
+        if (partial.count != 0) {
+            size_t total = summary.count + partial.count;
+            double delta = partial.mean - summary.mean;
+            summary.mean += delta * partial.count / total;
+            m2 += partial.variance + delta * delta * summary.count * partial.count / total;
+            summary.count = total;
+            summary.min = std::min(summary.min, partial.min);
+            summary.max = std::max(summary.max, partial.max);
+        }
+        for (size_t k = 0; k < histogram.bins; k++) {
+            summary.bins[k] += partial.bins[k];
+        }
+        summary.underflow += partial.underflow;
+        summary.overflow += partial.overflow;
+        summary.unordered += partial.unordered;
+    }
+    summary.variance = summary.count == 0 ? NAN : m2 / summary.count;
+    if (summary.count == 0) {
+        summary.mean = NAN;
+        summary.min = NAN;
+        summary.max = NAN;
+    }
+    return summary;
+}
+
+const size_t SinCosBlock = 256;
+
+// Walks t0 + i * dt by rotating (cos, sin) through the fixed angle dt, so each
+// sample costs four multiply-adds instead of two transcendental calls. The
+// rotation is re-anchored with std::sin/std::cos every UniformAnchor samples.
+// With T = max(|t0|, |t0 + (count - 1) * dt|) and |dt| <= 1, the error against
+// GetPoint(t0 + i * dt) stays below (2e-14 + 7e-16 * T) * radius (the larger
+// radius for an ellipse; helix z is computed directly and exact). The first
+// term is the drift of at most 63 rotations, measured at 5.2e-15; the second
+// is the rounding of the grid parameters, both t0 + i * dt and i * dt, whose
+// magnitudes are bounded by 2T, so at most 3 * 2^-52 * T; measured 4.3e-16 * T
+// over grids crossing zero from |t0| up to 3e4.
+const size_t UniformAnchor = 64;
+
+template <class F>
+inline void ForEachUniformSinCos(double t0, double dt, size_t count, F f) {
+    double cd = cos(dt);
+    double sd = sin(dt);
+    double s = 0.0;
+    double c = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        if (i % UniformAnchor == 0) {
+            double t = t0 + i * dt;
+            s = sin(t);
+            c = cos(t);
+        } else {
+            double next = s * cd + c * sd;
+            c = c * cd - s * sd;
+            s = next;
+        }
+        f(i, s, c);
+    }
+}
+
+// Runs the vector sin/cos over ts in stack-sized blocks and hands each
+// (index, sin, cos) to f, which assembles the curve-specific output. Float
+// inputs go through the float kernels.
+template <class Real, class F>
+inline void ForEachSinCos(const Real* ts, size_t count, F f) {
+    Real s[SinCosBlock];
+    Real c[SinCosBlock];
+    for (size_t i = 0; i < count; i += SinCosBlock) {
+        size_t n = std::min(count - i, SinCosBlock);
+        SinCos(ts + i, s, c, n);
+        for (size_t k = 0; k < n; k++) {
+            f(i + k, s[k], c[k]);
+        }
+    }
+}
+
+class Point3D {
+public:
+    double x, y, z;
+    Point3D() : x(0.0), y(0.0), z(0.0) {}
+    Point3D(double x, double y, double z) : x(x), y(y), z(z) {}
+};
+
+// Single-precision point for consumers that only need float output, such as
+// renderers; half the bytes of Point3D.
+class Point3F {
+public:
+    float x, y, z;
+    Point3F() : x(0.0f), y(0.0f), z(0.0f) {}
+    Point3F(float x, float y, float z) : x(x), y(y), z(z) {}
+};
+
+// Scalar-generic evaluation. A curve's formula is written once as a template
+// over T, which may be double, float, an F64/F32 pack (one parameter per
+// lane) or a Dual of any of those. Pack instantiations must run inside a
+// CURVE3D_TARGET function for their ISA, like the batch kernels.
+template <class T>
+struct Vector3 {
+    T x, y, z;
+};
+
+// Forward-mode dual number: a value and its derivative with respect to the
+// curve parameter, carried through the same arithmetic as the value.
+template <class T>
+struct Dual {
+    T value;
+    T derivative;
+};
+
+template <class T>
+Dual<T> operator+(const Dual<T>& a, const Dual<T>& b) { return { a.value + b.value, a.derivative + b.derivative }; }
+
+template <class T>
+Dual<T> operator-(const Dual<T>& a, const Dual<T>& b) { return { a.value - b.value, a.derivative - b.derivative }; }
+
+template <class T>
+Dual<T> operator*(const Dual<T>& a, const Dual<T>& b) { return { a.value * b.value, a.derivative * b.value + a.value * b.derivative }; }
+
+template <class T>
+Dual<T> operator*(const T& a, const Dual<T>& b) { return { a * b.value, a * b.derivative }; }
+
+// x as a value of the same type as like.
+template <class V>
+V Constant(double x, const V&) { return V::Set(typename V::Scalar(x)); }
+
+inline double Constant(double x, double) { return x; }
+inline float Constant(double x, float) { return float(x); }
+
+template <class T>
+Dual<T> Constant(double x, const Dual<T>&) { return { Constant(x, T()), Constant(0.0, T()) }; }
+
+// x as a curve parameter multiplying values like `like`; for duals that is
+// the underlying scalar, which skips the zero derivative part.
+template <class T>
+T Coefficient(double x, const T& like) { return Constant(x, like); }
+
+template <class T>
+T Coefficient(double x, const Dual<T>&) { return Constant(x, T()); }
+
+// -x by flipping the sign bit, so -(+0) is -0 exactly as unary minus gives.
+inline double Negate(double x) { return -x; }
+inline float Negate(float x) { return -x; }
+
+template <class V>
+V Negate(const V& x) { return x ^ V::Set(typename V::Scalar(-0.0)); }
+
+template <class T>
+Dual<T> Negate(const Dual<T>& x) { return { Negate(x.value), Negate(x.derivative) }; }
+
+inline void SinCosOf(double t, double& s, double& c) {
+    s = sin(t);
+    c = cos(t);
+}
+
+inline void SinCosOf(float t, float& s, float& c) {
+    s = std::sin(t);
+    c = std::cos(t);
+}
+
+template <class V>
+CURVE3D_INLINE void SinCosOf(const V& t, V& s, V& c) {
+    typename V::Scalar ts[V::Lanes];
+    typename V::Scalar ss[V::Lanes];
+    typename V::Scalar cs[V::Lanes];
+    t.Store(ts);
+    SinCosLanes<V>(ts, ss, cs);
+    s = V::Load(ss);
+    c = V::Load(cs);
+}
+
+template <class T>
+void SinCosOf(const Dual<T>& t, Dual<T>& s, Dual<T>& c) {
+    T sv, cv;
+    SinCosOf(t.value, sv, cv);
+    s = { sv, cv * t.derivative };
+    c = { cv, Negate(sv) * t.derivative };
+}
+
+inline Point3D MakePoint(const Vector3<double>& v) { return { v.x, v.y, v.z }; }
+inline Point3F MakePoint(const Vector3<float>& v) { return { v.x, v.y, v.z }; }
+
+// The built-in formulas, shared by the curve classes and by every flat or
+// columnar copy of their parameters: an ellipse in the z = 0 plane, and an
+// elliptic helix rising pitch per radian.
+template <class P, class T>
+Vector3<T> EllipseAt(const P& radiusX, const P& radiusY, const T& t, const T& s, const T& c) {
+    return { radiusX * c, radiusY * s, Constant(0.0, t) };
+}
+
+template <class P, class T>
+Vector3<T> HelixAt(const P& radiusX, const P& radiusY, const P& pitch, const T& t, const T& s, const T& c) {
+    return { radiusX * c, radiusY * s, pitch * t };
+}
+
+// Position at t of anything with an EvaluateAt(t, sin t, cos t).
+template <class Shape, class T>
+Vector3<T> EvaluateShape(const Shape& shape, const T& t) {
+    T s, c;
+    SinCosOf(t, s, c);
+    return shape.EvaluateAt(t, s, c);
+}
+
+// Position and tangent from a sin t and cos t already at hand, by evaluating
+// the shape's formula on dual numbers.
+template <class Shape, class T>
+void DifferentiateShape(const Shape& shape, const T& t, const T& s, const T& c, Vector3<T>& point, Vector3<T>& derivative) {
+    Dual<T> dt = { t, Constant(1.0, t) };
+    Dual<T> ds = { s, c };
+    Dual<T> dc = { c, Negate(s) };
+    Vector3<Dual<T>> v = shape.EvaluateAt(dt, ds, dc);
+    point = { v.x.value, v.y.value, v.z.value };
+    derivative = { v.x.derivative, v.y.derivative, v.z.derivative };
+}
+
+template <class Shape>
+void ShapePointAndDerivativeAt(const Shape& shape, double t, double sinT, double cosT, Point3D& point, Point3D& derivative) {
+    Vector3<double> p, d;
+    DifferentiateShape(shape, t, sinT, cosT, p, d);
+    point = MakePoint(p);
+    derivative = MakePoint(d);
+}
+
+template <class Shape>
+Point3D ShapeDerivative(const Shape& shape, double t) {
+    Point3D point, derivative;
+    ShapePointAndDerivativeAt(shape, t, sin(t), cos(t), point, derivative);
+    return derivative;
+}
+
+// The non-virtual evaluation methods of the curve classes, for flat and
+// columnar copies of their parameters, from Derived::EvaluateAt.
+template <class Derived>
+class ShapeEvaluation {
+private:
+    const Derived& Self() const { return static_cast<const Derived&>(*this); }
+
+public:
+    Point3D GetPoint(double t) const { return MakePoint(EvaluateShape(Self(), t)); }
+    Point3D GetDerivative(double t) const { return ShapeDerivative(Self(), t); }
+
+    void GetPointAndDerivativeAt(double t, double sinT, double cosT, Point3D& point, Point3D& derivative) const {
+        ShapePointAndDerivativeAt(Self(), t, sinT, cosT, point, derivative);
+    }
+};
+
+
+enum class CurveKind : uint8_t { Other, Circle, Ellipse, Helix };
+
+enum class CurveParameter { CircleRadius, EllipseRadiusX, EllipseRadiusY, HelixRadius, HelixStep };
+
+class Circle;
+class Ellipse;
+class Helix;
+
+template <class Derived>
+class ShapeCurve;
+
+// The kind tag a class may carry: only the built-in classes get their own,
+// since code holding a Curve3D static_casts on it.
+template <class T>
+constexpr CurveKind BuiltInKind() {
+    return std::is_same<T, Circle>::value ? CurveKind::Circle
+        : std::is_same<T, Ellipse>::value ? CurveKind::Ellipse
+        : std::is_same<T, Helix>::value ? CurveKind::Helix
+        : CurveKind::Other;
+}
+
+class Curve3D {
+private:
+    CurveKind kind;
+
+    template <class Derived>
+    friend class ShapeCurve;
+
+    explicit Curve3D(CurveKind kind) : kind(kind) {}
+
+protected:
+    // Other curve types are always tagged Other.
+    Curve3D() : kind(CurveKind::Other) {}
+    Curve3D(const Curve3D&) = default;
+    Curve3D& operator=(const Curve3D&) = default;
+
+    // Not virtual, so the built-in curves stay trivially destructible; curves
+    // are owned by their concrete type, and deleting through a Curve3D* does
+    // not compile.
+    ~Curve3D() = default;
+
+public:
+
+    // Stored at construction, so type checks are a byte compare instead of an RTTI walk.
+    CurveKind GetKind() const { return kind; }
+
+    virtual Point3D GetPoint(double t) const = 0;
+
+    virtual Point3D GetDerivative(double t) const = 0;
+
+    virtual void GetPoints(const double* ts, Point3D* out, size_t count) const {
+        for (size_t i = 0; i < count; i++) {
+            out[i] = GetPoint(ts[i]);
+        }
+    }
+
+    virtual void GetDerivatives(const double* ts, Point3D* out, size_t count) const {
+        for (size_t i = 0; i < count; i++) {
+            out[i] = GetDerivative(ts[i]);
+        }
+    }
+
+    virtual void GetPointAndDerivative(double t, Point3D& point, Point3D& derivative) const {
+        point = GetPoint(t);
+        derivative = GetDerivative(t);
+    }
+
+    virtual void GetPointAndDerivativeAt(double t, double /*sinT*/, double /*cosT*/, Point3D& point, Point3D& derivative) const {
+        GetPointAndDerivative(t, point, derivative);
+    }
+
+    virtual void GetPointsAndDerivatives(const double* ts, Point3D* points, Point3D* derivatives, size_t count) const {
+        for (size_t i = 0; i < count; i++) {
+            GetPointAndDerivative(ts[i], points[i], derivatives[i]);
+        }
+    }
+
+    virtual void SampleUniform(double t0, double dt, size_t count, Point3D* out) const {
+        for (size_t i = 0; i < count; i++) {
+            out[i] = GetPoint(t0 + i * dt);
+        }
+    }
+
+    // Single-precision batches, named apart from the double ones so a subclass
+    // overriding one set does not hide the other. These defaults evaluate in
+    // double and round; the built-in curves run the float kernels instead,
+    // measured within 2e-7 of the double path relative to the curve's largest
+    // coordinate for |t| <= 100 (--bench prints the figure).
+    virtual void GetPointsF(const float* ts, Point3F* out, size_t count) const {
+        for (size_t i = 0; i < count; i++) {
+            Point3D point = GetPoint(ts[i]);
+            out[i] = { float(point.x), float(point.y), float(point.z) };
+        }
+    }
+
+    virtual void GetDerivativesF(const float* ts, Point3F* out, size_t count) const {
+        for (size_t i = 0; i < count; i++) {
+            Point3D derivative = GetDerivative(ts[i]);
+            out[i] = { float(derivative.x), float(derivative.y), float(derivative.z) };
+        }
+    }
+
+    virtual void GetPointsAndDerivativesF(const float* ts, Point3F* points, Point3F* derivatives, size_t count) const {
+        GetPointsF(ts, points, count);
+        GetDerivativesF(ts, derivatives, count);
+    }
+};
+
+// Implements every Curve3D evaluation entry point, double and float, from
+// Derived::EvaluateAt(t, sin t, cos t), which feeds the curve's parameters to
+// EllipseAt or HelixAt. Derivatives evaluate that formula on dual numbers, so
+// they cannot drift from the points.
+template <class Derived>
+class ShapeCurve : public Curve3D {
+private:
+    const Derived& Self() const { return static_cast<const Derived&>(*this); }
+
+    template <class Real, class Point>
+    void PointsOf(const Real* ts, Point* out, size_t count) const {
+        ForEachSinCos(ts, count, [&](size_t i, Real s, Real c) {
+            out[i] = MakePoint(Self().EvaluateAt(ts[i], s, c));
+        });
+    }
+
+    template <class Real, class Point>
+    void DerivativesOf(const Real* ts, Point* out, size_t count) const {
+        ForEachSinCos(ts, count, [&](size_t i, Real s, Real c) {
+            Vector3<Real> point, derivative;
+            DifferentiateShape(Self(), ts[i], s, c, point, derivative);
+            out[i] = MakePoint(derivative);
+        });
+    }
+
+    template <class Real, class Point>
+    void PointsAndDerivativesOf(const Real* ts, Point* points, Point* derivatives, size_t count) const {
+        ForEachSinCos(ts, count, [&](size_t i, Real s, Real c) {
+            Vector3<Real> point, derivative;
+            DifferentiateShape(Self(), ts[i], s, c, point, derivative);
+            points[i] = MakePoint(point);
+            derivatives[i] = MakePoint(derivative);
+        });
+    }
+
+protected:
+    ShapeCurve() : Curve3D(BuiltInKind<Derived>()) {}
+    ShapeCurve(const ShapeCurve&) = default;
+    ShapeCurve& operator=(const ShapeCurve&) = default;
+    ~ShapeCurve() = default;
+
+public:
+    // Position at t for any engine scalar; with a Dual seeded with derivative
+    // one, the derivative parts hold the tangent.
+    template <class T>
+    Vector3<T> Evaluate(const T& t) const { return EvaluateShape(Self(), t); }
+
+    Point3D GetPoint(double t) const override { return MakePoint(Evaluate(t)); }
+    Point3D GetDerivative(double t) const override { return ShapeDerivative(Self(), t); }
+
+    void GetPoints(const double* ts, Point3D* out, size_t count) const override { PointsOf(ts, out, count); }
+    void GetDerivatives(const double* ts, Point3D* out, size_t count) const override { DerivativesOf(ts, out, count); }
+
+    void GetPointAndDerivative(double t, Point3D& point, Point3D& derivative) const override {
+        GetPointAndDerivativeAt(t, sin(t), cos(t), point, derivative);
+    }
+
+    void GetPointAndDerivativeAt(double t, double sinT, double cosT, Point3D& point, Point3D& derivative) const override {
+        ShapePointAndDerivativeAt(Self(), t, sinT, cosT, point, derivative);
+    }
+
+    void GetPointsAndDerivatives(const double* ts, Point3D* points, Point3D* derivatives, size_t count) const override {
+        PointsAndDerivativesOf(ts, points, derivatives, count);
+    }
+
+    void SampleUniform(double t0, double dt, size_t count, Point3D* out) const override {
+        ForEachUniformSinCos(t0, dt, count, [&](size_t i, double s, double c) {
+            out[i] = MakePoint(Self().EvaluateAt(t0 + i * dt, s, c));
+        });
+    }
+
+    void GetPointsF(const float* ts, Point3F* out, size_t count) const override { PointsOf(ts, out, count); }
+    void GetDerivativesF(const float* ts, Point3F* out, size_t count) const override { DerivativesOf(ts, out, count); }
+
+    void GetPointsAndDerivativesF(const float* ts, Point3F* points, Point3F* derivatives, size_t count) const override {
+        PointsAndDerivativesOf(ts, points, derivatives, count);
+    }
+};
+
+class Circle final : public ShapeCurve<Circle> {
+private:
+    double radius;
+
+public:
+    static const CurveKind Kind = CurveKind::Circle;
+
+    Circle(double radius) : radius(radius) {}
+
+    template <class T>
+    Vector3<T> EvaluateAt(const T& t, const T& s, const T& c) const {
+        auto r = Coefficient(radius, t);
+        return EllipseAt(r, r, t, s, c);
+    }
+
+    double GetRadius() const { return radius; }
+};
+
+
+class Ellipse final : public ShapeCurve<Ellipse> {
+private:
+    double radiusX;
+    double radiusY;
+
+public:
+    static const CurveKind Kind = CurveKind::Ellipse;
+
+    Ellipse(double radiusX, double radiusY) : radiusX(radiusX), radiusY(radiusY) {}
+
+    template <class T>
+    Vector3<T> EvaluateAt(const T& t, const T& s, const T& c) const {
+        return EllipseAt(Coefficient(radiusX, t), Coefficient(radiusY, t), t, s, c);
+    }
+
+    double GetRadiusX() const { return radiusX; }
+    double GetRadiusY() const { return radiusY; }
+};
+
+class Helix final : public ShapeCurve<Helix> {
+private:
+    double radius;
+    double step;
+    double pitch;
+
+public:
+    static const CurveKind Kind = CurveKind::Helix;
+
+    Helix(double radius, double step) : radius(radius), step(step), pitch(step / (2 * PI)) {}
+
+    template <class T>
+    Vector3<T> EvaluateAt(const T& t, const T& s, const T& c) const {
+        auto r = Coefficient(radius, t);
+        return HelixAt(r, r, Coefficient(pitch, t), t, s, c);
+    }
+
+    double GetRadius() const { return radius; }
+    double GetStep() const { return step; }
+
+    // Rise per radian, step / 2pi, computed once at construction.
+    double GetPitch() const { return pitch; }
+};
+
+// Curves grouped by concrete type, each type in its own contiguous array, so a
+// full pass is three linear scans and calls resolve statically.
+class CurveSet {
+private:
+    std::pmr::vector<Circle> circles;
+    std::pmr::vector<Ellipse> ellipses;
+    std::pmr::vector<Helix> helices;
+
+public:
+    // All three vectors allocate from resource, e.g. a pool for long-lived
+    // sets or a monotonic buffer for per-request ones.
+    explicit CurveSet(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : circles(resource), ellipses(resource), helices(resource) {}
+
+    std::pmr::memory_resource* GetResource() const { return circles.get_allocator().resource(); }
+
+    void Add(const Circle& circle) { circles.push_back(circle); }
+    void Add(const Ellipse& ellipse) { ellipses.push_back(ellipse); }
+    void Add(const Helix& helix) { helices.push_back(helix); }
+
+    size_t Size() const { return circles.size() + ellipses.size() + helices.size(); }
+
+    const std::pmr::vector<Circle>& GetCircles() const { return circles; }
+    const std::pmr::vector<Ellipse>& GetEllipses() const { return ellipses; }
+    const std::pmr::vector<Helix>& GetHelices() const { return helices; }
+
+    // Visits circles, then ellipses, then helices. f may take const Curve3D&
+    // or be generic to receive the concrete type.
+    template <class F>
+    void ForEach(F f) const {
+        for (const Circle& circle : circles) {
+            f(circle);
+        }
+        for (const Ellipse& ellipse : ellipses) {
+            f(ellipse);
+        }
+        for (const Helix& helix : helices) {
+            f(helix);
+        }
+    }
+
+    // Outputs follow ForEach order.
+    void EvaluateAll(double t, Point3D* points, Point3D* derivatives) const {
+        double sinT = sin(t);
+        double cosT = cos(t);
+        size_t i = 0;
+        ForEach([&](const auto& curve) {
+            curve.GetPointAndDerivativeAt(t, sinT, cosT, points[i], derivatives[i]);
+            i++;
+        });
+    }
+};
+
+// Compact curve record without a vptr: the kind tag and the three numbers every
+// built-in curve evaluates with, x = radiusX cos t, y = radiusY sin t,
+// z = pitch t. Circles repeat the radius and leave the pitch zero, so a batch of
+// mixed records evaluates without branching on the kind. As CurveRecord<float>
+// one curve is 16 bytes, against 24 to 40 for the classes.
+template <class Real>
+class CurveRecord : public ShapeEvaluation<CurveRecord<Real>> {
+private:
+    CurveKind kind;
+    Real radiusX;
+    Real radiusY;
+    Real pitch;
+
+public:
+    CurveRecord(const Circle& circle)
+        : kind(CurveKind::Circle), radiusX(Real(circle.GetRadius())), radiusY(radiusX), pitch(0) {}
+    CurveRecord(const Ellipse& ellipse)
+        : kind(CurveKind::Ellipse), radiusX(Real(ellipse.GetRadiusX())), radiusY(Real(ellipse.GetRadiusY())), pitch(0) {}
+    CurveRecord(const Helix& helix)
+        : kind(CurveKind::Helix), radiusX(Real(helix.GetRadius())), radiusY(radiusX), pitch(Real(helix.GetPitch())) {}
+
+    CurveKind GetKind() const { return kind; }
+    double GetRadiusX() const { return radiusX; }
+    double GetRadiusY() const { return radiusY; }
+    double GetPitch() const { return pitch; }
+
+    // Every kind as an elliptic helix: circles have equal radii and, with
+    // ellipses, zero pitch.
+    template <class T>
+    Vector3<T> EvaluateAt(const T& t, const T& s, const T& c) const {
+        return HelixAt(Coefficient(radiusX, t), Coefficient(radiusY, t), Coefficient(pitch, t), t, s, c);
+    }
+};
+
+static_assert(sizeof(CurveRecord<float>) == 16, "float curve records are meant to pack four to a cache line");
+
+// Records for every curve in the set, in ForEach order.
+template <class Real>
+std::vector<CurveRecord<Real>> MakeRecords(const CurveSet& set) {
+    std::vector<CurveRecord<Real>> records;
+    records.reserve(set.Size());
+    set.ForEach([&](const auto& curve) { records.push_back(CurveRecord<Real>(curve)); });
+    return records;
+}
+
+// Same output as CurveSet::EvaluateAll for the set the records came from, up
+// to the storage precision.
+template <class Real>
+void EvaluateAll(const CurveRecord<Real>* records, size_t count, double t, Point3D* points, Point3D* derivatives) {
+    double sinT = sin(t);
+    double cosT = cos(t);
+    for (size_t i = 0; i < count; i++) {
+        records[i].GetPointAndDerivativeAt(t, sinT, cosT, points[i], derivatives[i]);
+    }
+}
+
+// Non-owning views over one row of CurveColumns. They evaluate like the classes
+// they mirror without materializing an object.
+class CircleView : public ShapeEvaluation<CircleView> {
+private:
+    const double* radius;
+
+public:
+    explicit CircleView(const double* radius) : radius(radius) {}
+
+    template <class T>
+    Vector3<T> EvaluateAt(const T& t, const T& s, const T& c) const {
+        auto r = Coefficient(*radius, t);
+        return EllipseAt(r, r, t, s, c);
+    }
+
+    double GetRadius() const { return *radius; }
+};
+
+class EllipseView : public ShapeEvaluation<EllipseView> {
+private:
+    const double* radiusX;
+    const double* radiusY;
+
+public:
+    EllipseView(const double* radiusX, const double* radiusY) : radiusX(radiusX), radiusY(radiusY) {}
+
+    template <class T>
+    Vector3<T> EvaluateAt(const T& t, const T& s, const T& c) const {
+        return EllipseAt(Coefficient(*radiusX, t), Coefficient(*radiusY, t), t, s, c);
+    }
+
+    double GetRadiusX() const { return *radiusX; }
+    double GetRadiusY() const { return *radiusY; }
+};
+
+class HelixView : public ShapeEvaluation<HelixView> {
+private:
+    const double* radius;
+    const double* step;
+    const double* pitch;
+
+public:
+    HelixView(const double* radius, const double* step, const double* pitch) : radius(radius), step(step), pitch(pitch) {}
+
+    template <class T>
+    Vector3<T> EvaluateAt(const T& t, const T& s, const T& c) const {
+        auto r = Coefficient(*radius, t);
+        return HelixAt(r, r, Coefficient(*pitch, t), t, s, c);
+    }
+
+    double GetRadius() const { return *radius; }
+    double GetStep() const { return *step; }
+};
+
+// Structure-of-arrays copy of the curve parameters, one column per field, so
+// bulk passes stream only the columns they read.
+class CurveColumns {
+private:
+    std::vector<double> circleRadius;
+    std::vector<double> ellipseRadiusX;
+    std::vector<double> ellipseRadiusY;
+    std::vector<double> helixRadius;
+    std::vector<double> helixStep;
+    std::vector<double> helixPitch;
+
+public:
+    CurveColumns() {}
+
+    explicit CurveColumns(const CurveSet& set) {
+        for (const Circle& circle : set.GetCircles()) {
+            Add(circle);
+        }
+        for (const Ellipse& ellipse : set.GetEllipses()) {
+            Add(ellipse);
+        }
+        for (const Helix& helix : set.GetHelices()) {
+            Add(helix);
+        }
+    }
+
+    void Add(const Circle& circle) {
+        circleRadius.push_back(circle.GetRadius());
+    }
+
+    void Add(const Ellipse& ellipse) {
+        ellipseRadiusX.push_back(ellipse.GetRadiusX());
+        ellipseRadiusY.push_back(ellipse.GetRadiusY());
+    }
+
+    void Add(const Helix& helix) {
+        helixRadius.push_back(helix.GetRadius());
+        helixStep.push_back(helix.GetStep());
+        helixPitch.push_back(helix.GetPitch());
+    }
+
+    size_t Size() const { return circleRadius.size() + ellipseRadiusX.size() + helixRadius.size(); }
+    size_t CircleCount() const { return circleRadius.size(); }
+    size_t EllipseCount() const { return ellipseRadiusX.size(); }
+    size_t HelixCount() const { return helixRadius.size(); }
+
+    const std::vector<double>& GetCircleRadii() const { return circleRadius; }
+    const std::vector<double>& GetEllipseRadiiX() const { return ellipseRadiusX; }
+    const std::vector<double>& GetEllipseRadiiY() const { return ellipseRadiusY; }
+    const std::vector<double>& GetHelixRadii() const { return helixRadius; }
+    const std::vector<double>& GetHelixSteps() const { return helixStep; }
+
+    // Derived from the steps at insertion, so evaluation never divides.
+    const std::vector<double>& GetHelixPitches() const { return helixPitch; }
+
+    const std::vector<double>& GetColumn(CurveParameter parameter) const {
+        switch (parameter) {
+        case CurveParameter::EllipseRadiusX: return ellipseRadiusX;
+        case CurveParameter::EllipseRadiusY: return ellipseRadiusY;
+        case CurveParameter::HelixRadius: return helixRadius;
+        case CurveParameter::HelixStep: return helixStep;
+        default: return circleRadius;
+        }
+    }
+
+    CircleView GetCircle(size_t i) const { return CircleView(&circleRadius[i]); }
+    EllipseView GetEllipse(size_t i) const { return EllipseView(&ellipseRadiusX[i], &ellipseRadiusY[i]); }
+    HelixView GetHelix(size_t i) const { return HelixView(&helixRadius[i], &helixStep[i], &helixPitch[i]); }
+
+    // Same output order as CurveSet::EvaluateAll: circles, ellipses, helices.
+    void EvaluateAll(double t, Point3D* points, Point3D* derivatives) const {
+        double sinT = sin(t);
+        double cosT = cos(t);
+        for (size_t i = 0; i < circleRadius.size(); i++) {
+            GetCircle(i).GetPointAndDerivativeAt(t, sinT, cosT, points[i], derivatives[i]);
+        }
+        points += circleRadius.size();
+        derivatives += circleRadius.size();
+
+        for (size_t i = 0; i < ellipseRadiusX.size(); i++) {
+            GetEllipse(i).GetPointAndDerivativeAt(t, sinT, cosT, points[i], derivatives[i]);
+        }
+        points += ellipseRadiusX.size();
+        derivatives += ellipseRadiusX.size();
+
+        for (size_t i = 0; i < helixRadius.size(); i++) {
+            GetHelix(i).GetPointAndDerivativeAt(t, sinT, cosT, points[i], derivatives[i]);
+        }
+    }
+
+    double SumCircleRadii(SumMode mode = SumMode::Fast) const {
+        return ReduceSum(circleRadius.data(), circleRadius.size(), mode);
+    }
+
+    // Row indices of the circles with lo <= radius <= hi.
+    std::pmr::vector<size_t> FindCircles(double lo, double hi,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const {
+        std::pmr::vector<size_t> rows(resource);
+        for (size_t i = 0; i < circleRadius.size(); i++) {
+            if (circleRadius[i] >= lo && circleRadius[i] <= hi) {
+                rows.push_back(i);
+            }
+        }
+        return rows;
+    }
+};
+
+// Closed-set value type: curves are stored inline and std::visit dispatches
+// over the three final classes, so calls can be inlined. Curve3D stays the
+// open interface for other curve types.
+using CurveValue = std::variant<Circle, Ellipse, Helix>;
+
+inline const Curve3D& AsCurve3D(const CurveValue& curve) {
+    return std::visit([](const auto& c) -> const Curve3D& { return c; }, curve);
+}
+
+inline Point3D GetPoint(const CurveValue& curve, double t) {
+    return std::visit([t](const auto& c) { return c.GetPoint(t); }, curve);
+}
+
+inline Point3D GetDerivative(const CurveValue& curve, double t) {
+    return std::visit([t](const auto& c) { return c.GetDerivative(t); }, curve);
+}
+
+inline void GetPointAndDerivativeAt(const CurveValue& curve, double t, double sinT, double cosT, Point3D& point, Point3D& derivative) {
+    std::visit([&](const auto& c) { c.GetPointAndDerivativeAt(t, sinT, cosT, point, derivative); }, curve);
+}
+
+// Open-set value type: holds any Curve3D subclass of up to Size bytes in
+// place, so a vector of them is contiguous like one of CurveValue while
+// third-party curves still plug in through the virtual interface. Curve3D has
+// no virtual destructor, so copies and destruction go through functions
+// generated for the stored type. If a copy assignment throws, the target is
+// left empty: it may only be assigned to or destroyed.
+template <size_t Size>
+class InlineCurve {
+private:
+    struct Operations {
+        void (*copy)(void* target, const void* source);
+        void (*destroy)(void* object);
+    };
+
+    template <class T>
+    static const Operations* OperationsFor() {
+        static const Operations operations = {
+            [](void* target, const void* source) { new (target) T(*std::launder(static_cast<const T*>(source))); },
+            [](void* object) { std::launder(static_cast<T*>(object))->~T(); },
+        };
+        return &operations;
+    }
+
+    alignas(std::max_align_t) unsigned char storage[Size];
+    const Operations* operations;
+    uint32_t baseOffset;
+
+    template <class T, class... Args>
+    void Construct(Args&&... args) {
+        static_assert(std::is_base_of<Curve3D, T>::value, "InlineCurve holds Curve3D subclasses");
+        static_assert(sizeof(T) <= Size && alignof(T) <= alignof(std::max_align_t), "curve does not fit InlineCurve");
+        T* curve = new (storage) T(std::forward<Args>(args)...);
+        operations = OperationsFor<T>();
+        baseOffset = static_cast<uint32_t>(reinterpret_cast<const unsigned char*>(static_cast<const Curve3D*>(curve)) - storage);
+    }
+
+public:
+    template <class T, class = typename std::enable_if<std::is_base_of<Curve3D, typename std::decay<T>::type>::value>::type>
+    InlineCurve(T&& curve) {
+        Construct<typename std::decay<T>::type>(std::forward<T>(curve));
+    }
+
+    template <class T, class... Args>
+    explicit InlineCurve(std::in_place_type_t<T>, Args&&... args) {
+        Construct<T>(std::forward<Args>(args)...);
+    }
+
+    InlineCurve(const InlineCurve& other) : operations(other.operations), baseOffset(other.baseOffset) {
+        if (operations != nullptr) {
+            operations->copy(storage, other.storage);
+        }
+    }
+
+    InlineCurve& operator=(const InlineCurve& other) {
+        if (this != &other) {
+            if (operations != nullptr) {
+                operations->destroy(storage);
+                operations = nullptr;
+            }
+            if (other.operations != nullptr) {
+                other.operations->copy(storage, other.storage);
+                operations = other.operations;
+                baseOffset = other.baseOffset;
+            }
+        }
+        return *this;
+    }
+
+    ~InlineCurve() {
+        if (operations != nullptr) {
+            operations->destroy(storage);
+        }
+    }
+
+    const Curve3D& Get() const { return *std::launder(reinterpret_cast<const Curve3D*>(storage + baseOffset)); }
+    const Curve3D* operator->() const { return &Get(); }
+
+    Point3D GetPoint(double t) const { return Get().GetPoint(t); }
+    Point3D GetDerivative(double t) const { return Get().GetDerivative(t); }
+};
+
+inline const Curve3D* CurvePointer(const Curve3D* curve) { return curve; }
+inline const Curve3D* CurvePointer(const CurveValue& curve) { return &AsCurve3D(curve); }
+
+template <size_t Size>
+const Curve3D* CurvePointer(const InlineCurve<Size>& curve) { return &curve.Get(); }
+
+// Typed subset of any collection of curves (pointers, InlineCurves or CurveValues),
+// selected by the stored kind tag. CurveSet already keeps each kind apart, so
+// prefer GetCircles() and friends there.
+template <class T, class Range>
+std::vector<const T*> FilterByKind(const Range& curves) {
+    std::vector<const T*> result;
+    for (const auto& element : curves) {
+        const Curve3D* curve = CurvePointer(element);
+        if (curve->GetKind() == T::Kind) {
+            result.push_back(static_cast<const T*>(curve));
+        }
+    }
+    return result;
+}
+
+// Bump allocator for building many curves at once. Objects are carved out of
+// large chunks, optionally backed by huge pages where the OS grants them, and
+// released all together: destructors run only for types that need them, so
+// tearing down trivially destructible curves is just freeing the chunks.
+// As a memory_resource it behaves like a monotonic buffer.
+class CurveArena : public std::pmr::memory_resource {
+private:
+    struct Chunk {
+        char* memory;
+        size_t size;
+        bool mapped;
+    };
+
+    struct Destructor {
+        void (*destroy)(void*);
+        void* object;
+    };
+
+    size_t chunkSize;
+    bool hugePages;
+    std::vector<Chunk> chunks;
+    std::vector<Destructor> destructors;
+    char* cursor;
+    char* end;
+
+    Chunk AllocateChunk(size_t size) {
+#ifdef _WIN32
+        if (hugePages) {
+            size_t page = GetLargePageMinimum();
+            if (page != 0) {
+                size_t rounded = (size + page - 1) / page * page;
+                void* memory = VirtualAlloc(nullptr, rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+                if (memory != nullptr) {
+                    return { static_cast<char*>(memory), rounded, true };
+                }
+            }
+        }
+#elif defined(__linux__)
+        if (hugePages) {
+            void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory != MAP_FAILED) {
+#ifdef MADV_HUGEPAGE
+                madvise(memory, size, MADV_HUGEPAGE);
+#endif
+                return { static_cast<char*>(memory), size, true };
+            }
+        }
+#endif
+        return { static_cast<char*>(::operator new(size)), size, false };
+    }
+
+    void* do_allocate(size_t size, size_t alignment) override { return Allocate(size, alignment); }
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    void FreeChunk(const Chunk& chunk) {
+        if (!chunk.mapped) {
+            ::operator delete(chunk.memory);
+            return;
+        }
+#ifdef _WIN32
+        VirtualFree(chunk.memory, 0, MEM_RELEASE);
+#elif defined(__linux__)
+        munmap(chunk.memory, chunk.size);
+#endif
+    }
+
+public:
+    explicit CurveArena(size_t chunkSize = 1 << 21, bool hugePages = false)
+        : chunkSize(chunkSize), hugePages(hugePages), cursor(nullptr), end(nullptr) {}
+
+    CurveArena(const CurveArena&) = delete;
+    CurveArena& operator=(const CurveArena&) = delete;
+
+    ~CurveArena() { Release(); }
+
+    void* Allocate(size_t size, size_t alignment) {
+        uintptr_t address = reinterpret_cast<uintptr_t>(cursor);
+        uintptr_t aligned = (address + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+        if (cursor == nullptr || aligned + size > reinterpret_cast<uintptr_t>(end)) {
+            Chunk chunk = AllocateChunk(std::max(chunkSize, size + alignment));
+            chunks.push_back(chunk);
+            cursor = chunk.memory;
+            end = chunk.memory + chunk.size;
+            address = reinterpret_cast<uintptr_t>(cursor);
+            aligned = (address + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+        }
+        cursor += aligned - address + size;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    template <class T, class... Args>
+    T* Create(Args&&... args) {
+        T* object = new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value) {
+            destructors.push_back({ [](void* p) { static_cast<T*>(p)->~T(); }, object });
+        }
+        return object;
+    }
+
+    // Destroys everything created so far, newest first, and frees the chunks.
+    void Release() {
+        for (size_t i = destructors.size(); i > 0; i--) {
+            destructors[i - 1].destroy(destructors[i - 1].object);
+        }
+        destructors.clear();
+        for (const Chunk& chunk : chunks) {
+            FreeChunk(chunk);
+        }
+        chunks.clear();
+        cursor = nullptr;
+        end = nullptr;
+    }
+
+    size_t ChunkCount() const { return chunks.size(); }
 };
 
+static_assert(std::is_trivially_destructible<Circle>::value && std::is_trivially_destructible<Ellipse>::value &&
+    std::is_trivially_destructible<Helix>::value, "CurveArena frees built-in curves without running destructors");
+
+// Count, compensated sum, min and max of one curve parameter, updated per
+// value added or removed. Queries are O(1); updates are O(log d) in the number
+// of distinct values, which min and max need to survive removals.
+class ParameterAggregate {
+private:
+    size_t count;
+    CompensatedSum sum;
+    std::pmr::map<double, size_t> values;
 
-class Curve3D {
 public:
+    explicit ParameterAggregate(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : count(0), sum({ 0.0, 0.0 }), values(resource) {}
 
-    virtual Point3D GetPoint(double t) const = 0;
+    void Add(double x) {
+        count++;
+        NeumaierAdd(sum, x);
+        values[x]++;
+    }
 
-    virtual Point3D GetDerivative(double t) const = 0;
+    void Remove(double x) {
+        auto value = values.find(x);
+        if (value == values.end()) {
+            return;
+        }
+        if (--value->second == 0) {
+            values.erase(value);
+        }
+        count--;
+        NeumaierAdd(sum, -x);
+        if (count == 0) {
+            sum = { 0.0, 0.0 };
+        }
+    }
+
+    size_t Count() const { return count; }
+    double Sum() const { return sum.Value(); }
+    double Mean() const { return count == 0 ? NAN : sum.Value() / count; }
+    double Min() const { return values.empty() ? NAN : values.begin()->first; }
+    double Max() const { return values.empty() ? NAN : values.rbegin()->first; }
 };
 
-class Circle : public Curve3D {
+// Identifies a curve in a CurveRegistry. The generation makes handles to
+// removed curves detectably stale once their slot is reused.
+struct CurveHandle {
+    uint32_t index;
+    uint32_t generation;
+
+    bool operator==(const CurveHandle& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const CurveHandle& other) const { return !(*this == other); }
+};
+
+// Owns curves of any Curve3D type behind stable handles and keeps, per kind,
+// the list of live handles up to date on every insert and remove, so typed
+// subsets are available without scanning.
+class CurveRegistry {
 private:
-    double radius;
+    // Destroys a curve and hands its memory back to the registry's resource.
+    struct CurveDeleter {
+        void (*destroy)(Curve3D*, std::pmr::memory_resource*);
+        std::pmr::memory_resource* resource;
+
+        void operator()(Curve3D* curve) const { destroy(curve, resource); }
+    };
+
+    struct Slot {
+        std::unique_ptr<Curve3D, CurveDeleter> curve;
+        uint32_t generation;
+        uint32_t position;
+    };
+
+    static const size_t KindCount = 4;
+
+    std::pmr::memory_resource* resource;
+    std::pmr::vector<Slot> slots;
+    std::pmr::vector<uint32_t> freeSlots;
+    std::pmr::vector<CurveHandle> byKind[KindCount];
+
+    static const size_t ParameterCount = 5;
+
+    ParameterAggregate aggregates[ParameterCount];
+
+    std::pmr::vector<CurveHandle>& KindIndex(const Curve3D& curve) { return byKind[static_cast<size_t>(curve.GetKind())]; }
+
+    void Aggregate(const Curve3D& curve, bool add) {
+        auto apply = [&](CurveParameter parameter, double value) {
+            ParameterAggregate& aggregate = aggregates[static_cast<size_t>(parameter)];
+            if (add) {
+                aggregate.Add(value);
+            } else {
+                aggregate.Remove(value);
+            }
+        };
+
+        switch (curve.GetKind()) {
+        case CurveKind::Circle:
+            apply(CurveParameter::CircleRadius, static_cast<const Circle&>(curve).GetRadius());
+            break;
+        case CurveKind::Ellipse:
+            apply(CurveParameter::EllipseRadiusX, static_cast<const Ellipse&>(curve).GetRadiusX());
+            apply(CurveParameter::EllipseRadiusY, static_cast<const Ellipse&>(curve).GetRadiusY());
+            break;
+        case CurveKind::Helix:
+            apply(CurveParameter::HelixRadius, static_cast<const Helix&>(curve).GetRadius());
+            apply(CurveParameter::HelixStep, static_cast<const Helix&>(curve).GetStep());
+            break;
+        default:
+            break;
+        }
+    }
 
 public:
-    Circle(double radius) : radius(radius) {}
+    // Curves, slots, kind indices and aggregates all allocate from resource,
+    // which must outlive the registry. With a CurveArena the registry runs each
+    // curve's destructor and the arena only frees the chunks, so every curve is
+    // destroyed exactly once.
+    explicit CurveRegistry(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : resource(resource), slots(resource), freeSlots(resource),
+          byKind{ std::pmr::vector<CurveHandle>(resource), std::pmr::vector<CurveHandle>(resource),
+              std::pmr::vector<CurveHandle>(resource), std::pmr::vector<CurveHandle>(resource) },
+          aggregates{ ParameterAggregate(resource), ParameterAggregate(resource), ParameterAggregate(resource),
+              ParameterAggregate(resource), ParameterAggregate(resource) } {}
+
+    std::pmr::memory_resource* GetResource() const { return resource; }
+
+    template <class T, class... Args>
+    CurveHandle Emplace(Args&&... args) {
+        void* memory = resource->allocate(sizeof(T), alignof(T));
+        T* object;
+        try {
+            object = new (memory) T(std::forward<Args>(args)...);
+        } catch (...) {
+            resource->deallocate(memory, sizeof(T), alignof(T));
+            throw;
+        }
+        std::unique_ptr<Curve3D, CurveDeleter> curve(object, { [](Curve3D* p, std::pmr::memory_resource* from) {
+            T* object = static_cast<T*>(p);
+            object->~T();
+            from->deallocate(object, sizeof(T), alignof(T));
+        }, resource });
+
+        uint32_t index;
+        if (freeSlots.empty()) {
+            index = static_cast<uint32_t>(slots.size());
+            slots.push_back({ std::move(curve), 0, 0 });
+        } else {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+            slots[index].curve = std::move(curve);
+        }
 
-    Point3D GetPoint(double t) const override {
-        double x = radius * cos(t);
-        double y = radius * sin(t);
-        double z = 0.0;
+        Slot& slot = slots[index];
+        CurveHandle handle = { index, slot.generation };
+        std::pmr::vector<CurveHandle>& kindIndex = KindIndex(*slot.curve);
+        slot.position = static_cast<uint32_t>(kindIndex.size());
+        kindIndex.push_back(handle);
+        Aggregate(*slot.curve, true);
+        return handle;
+    }
 
-        return { x, y, z };
+    // Changes the parameters of a live curve in place; the replacement must be
+    // of the same type. Returns false for stale handles or a type mismatch.
+    template <class T>
+    bool Update(CurveHandle handle, const T& curve) {
+        if (Get<T>(handle) == nullptr) {
+            return false;
+        }
+        T& current = static_cast<T&>(*slots[handle.index].curve);
+        Aggregate(current, false);
+        current = curve;
+        Aggregate(current, true);
+        return true;
     }
 
-    Point3D GetDerivative(double t) const override {
-        double x = -radius * sin(t);
-        double y = radius * cos(t);
-        double z = 0.0;
+    bool Remove(CurveHandle handle) {
+        if (Get(handle) == nullptr) {
+            return false;
+        }
+
+        Slot& slot = slots[handle.index];
+        Aggregate(*slot.curve, false);
+        std::pmr::vector<CurveHandle>& kindIndex = KindIndex(*slot.curve);
+        CurveHandle moved = kindIndex.back();
+        kindIndex[slot.position] = moved;
+        slots[moved.index].position = slot.position;
+        kindIndex.pop_back();
 
-        return { x, y, z };
+        slot.curve.reset();
+        slot.generation++;
+        freeSlots.push_back(handle.index);
+        return true;
     }
 
-    double GetRadius() const { return radius; }
+    // nullptr when the handle is stale.
+    const Curve3D* Get(CurveHandle handle) const {
+        if (handle.index >= slots.size() || slots[handle.index].generation != handle.generation) {
+            return nullptr;
+        }
+        return slots[handle.index].curve.get();
+    }
+
+    // nullptr when the handle is stale or refers to another kind.
+    template <class T>
+    const T* Get(CurveHandle handle) const {
+        const Curve3D* curve = Get(handle);
+        if (curve == nullptr || curve->GetKind() != T::Kind) {
+            return nullptr;
+        }
+        return static_cast<const T*>(curve);
+    }
+
+    // Live handles of one kind, in no particular order.
+    const std::pmr::vector<CurveHandle>& GetHandles(CurveKind kind) const { return byKind[static_cast<size_t>(kind)]; }
+
+    size_t Size() const { return slots.size() - freeSlots.size(); }
+
+    const ParameterAggregate& GetAggregate(CurveParameter parameter) const { return aggregates[static_cast<size_t>(parameter)]; }
+
+    // Rebuilds every aggregate from the live curves.
+    void RecomputeAggregates() {
+        for (ParameterAggregate& aggregate : aggregates) {
+            aggregate = ParameterAggregate(resource);
+        }
+        for (const Slot& slot : slots) {
+            if (slot.curve) {
+                Aggregate(*slot.curve, true);
+            }
+        }
+    }
+
+    // Checks the maintained aggregates against a fresh recomputation: counts,
+    // min and max exactly, sums to within a few ulps of the summed magnitudes.
+    bool VerifyAggregates() const {
+        CurveRegistry fresh(resource);
+        for (const Slot& slot : slots) {
+            if (slot.curve) {
+                fresh.Aggregate(*slot.curve, true);
+            }
+        }
+        for (size_t i = 0; i < ParameterCount; i++) {
+            const ParameterAggregate& kept = aggregates[i];
+            const ParameterAggregate& expected = fresh.aggregates[i];
+            bool same = kept.Count() == expected.Count() &&
+                (kept.Count() == 0 || (kept.Min() == expected.Min() && kept.Max() == expected.Max() &&
+                fabs(kept.Sum() - expected.Sum()) <= 4e-16 * kept.Count() * std::max(fabs(kept.Min()), fabs(kept.Max()))));
+            if (!same) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Evaluates every curve at the same t with a single sin/cos, leaving only the
+// per-curve scaling to each curve. curves is any range FilterByKind accepts,
+// e.g. a std::vector<const Curve3D*>.
+template <class Range>
+void EvaluateAll(const Range& curves, double t, Point3D* points, Point3D* derivatives) {
+    double sinT = sin(t);
+    double cosT = cos(t);
+    size_t i = 0;
+    for (const auto& element : curves) {
+        CurvePointer(element)->GetPointAndDerivativeAt(t, sinT, cosT, points[i], derivatives[i]);
+        i++;
+    }
+}
+
+// Sort record: a key such as a radius plus the position of its curve in the
+// source collection.
+struct KeyedIndex {
+    double key;
+    size_t index;
 };
 
+inline bool KeyLess(const KeyedIndex& a, const KeyedIndex& b) {
+    return a.key < b.key;
+}
+
+// Maps a double to an unsigned integer with the same ordering: negative values
+// get all bits flipped, non-negative ones only the sign bit. -0 is taken as +0
+// first, since KeyLess treats them as equal keys.
+inline uint64_t SortableBits(double key) {
+    uint64_t bits = DoubleToBits(key == 0.0 ? 0.0 : key);
+    return (bits >> 63) != 0 ? ~bits : bits | (uint64_t(1) << 63);
+}
+
+// Stable LSD radix sort on the key, eight passes of one byte each; passes
+// where every key has the same byte are skipped. Working buffers come from
+// scratch, so a monotonic resource keeps repeated sorts off the global heap.
+template <class Allocator>
+void RadixSortByKey(std::vector<KeyedIndex, Allocator>& items, std::pmr::memory_resource* scratch = std::pmr::get_default_resource()) {
+    const size_t Passes = 8;
+    size_t n = items.size();
+    if (n < 2) {
+        return;
+    }
+
+    std::pmr::vector<size_t> counts(Passes * 256, 0, scratch);
+    for (const KeyedIndex& item : items) {
+        uint64_t bits = SortableBits(item.key);
+        for (size_t pass = 0; pass < Passes; pass++) {
+            counts[pass * 256 + ((bits >> (pass * 8)) & 0xFF)]++;
+        }
+    }
+
+    std::pmr::vector<KeyedIndex> buffer(n, scratch);
+    KeyedIndex* source = items.data();
+    KeyedIndex* target = buffer.data();
+    for (size_t pass = 0; pass < Passes; pass++) {
+        size_t* count = &counts[pass * 256];
+        size_t shift = pass * 8;
+        if (count[(SortableBits(source[0].key) >> shift) & 0xFF] == n) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (size_t digit = 0; digit < 256; digit++) {
+            size_t c = count[digit];
+            count[digit] = offset;
+            offset += c;
+        }
+        for (size_t i = 0; i < n; i++) {
+            target[count[(SortableBits(source[i].key) >> shift) & 0xFF]++] = source[i];
+        }
+        std::swap(source, target);
+    }
+
+    if (source != items.data()) {
+        std::copy(source, source + n, items.data());
+    }
+}
+
+const size_t CountingSortMaxKeys = 256;
+
+// Stable counting sort for inputs with at most CountingSortMaxKeys distinct
+// keys. One pass numbers the distinct keys through a small open-addressing
+// table and counts them, a second pass scatters every record into place.
+// Returns false, leaving items untouched, when there are more distinct keys.
+template <class Allocator>
+bool CountingSortByKey(std::vector<KeyedIndex, Allocator>& items, std::pmr::memory_resource* scratch = std::pmr::get_default_resource()) {
+    const size_t TableSize = 4 * CountingSortMaxKeys;
+    size_t n = items.size();
+    std::pmr::vector<uint64_t> tableKeys(TableSize, scratch);
+    std::pmr::vector<int> tableIds(TableSize, -1, scratch);
+    std::pmr::vector<uint64_t> keys(scratch);
+    std::pmr::vector<size_t> counts(scratch);
+    std::pmr::vector<uint8_t> buckets(n, scratch);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t bits = SortableBits(items[i].key);
+        size_t slot = static_cast<size_t>((bits * 0x9E3779B97F4A7C15ull) >> 54) & (TableSize - 1);
+        while (tableIds[slot] >= 0 && tableKeys[slot] != bits) {
+            slot = (slot + 1) & (TableSize - 1);
+        }
+        if (tableIds[slot] < 0) {
+            if (keys.size() == CountingSortMaxKeys) {
+                return false;
+            }
+            tableKeys[slot] = bits;
+            tableIds[slot] = static_cast<int>(keys.size());
+            keys.push_back(bits);
+            counts.push_back(0);
+        }
+        buckets[i] = static_cast<uint8_t>(tableIds[slot]);
+        counts[buckets[i]]++;
+    }
+
+    std::pmr::vector<size_t> order(keys.size(), scratch);
+    for (size_t id = 0; id < order.size(); id++) {
+        order[id] = id;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return keys[a] < keys[b]; });
+    std::pmr::vector<size_t> offsets(keys.size(), scratch);
+    size_t offset = 0;
+    for (size_t id : order) {
+        offsets[id] = offset;
+        offset += counts[id];
+    }
+
+    std::pmr::vector<KeyedIndex> sorted(n, scratch);
+    for (size_t i = 0; i < n; i++) {
+        sorted[offsets[buckets[i]]++] = items[i];
+    }
+    std::copy(sorted.begin(), sorted.end(), items.begin());
+    return true;
+}
+
+// Distinct keys among up to `samples` evenly spaced records.
+template <class Allocator>
+size_t SampleDistinctKeys(const std::vector<KeyedIndex, Allocator>& items, size_t samples, std::pmr::memory_resource* scratch = std::pmr::get_default_resource()) {
+    size_t stride = std::max<size_t>(1, items.size() / samples);
+    std::pmr::vector<uint64_t> keys(scratch);
+    for (size_t i = 0; i < items.size(); i += stride) {
+        keys.push_back(SortableBits(items[i].key));
+    }
+    std::sort(keys.begin(), keys.end());
+    return std::unique(keys.begin(), keys.end()) - keys.begin();
+}
+
+enum class SortMode { Auto, Comparison, Radix, Counting };
+
+// Stable sort of records by key. Auto samples the keys and takes the counting
+// sort when they look low-cardinality, otherwise radix sort for large inputs
+// and std::stable_sort for small ones. Counting falls back to std::stable_sort
+// when there turn out to be too many distinct keys.
+template <class Allocator>
+void SortByKey(std::vector<KeyedIndex, Allocator>& items, SortMode mode = SortMode::Auto,
+    std::pmr::memory_resource* scratch = std::pmr::get_default_resource()) {
+    const size_t SmallLimit = 256;
+    switch (mode) {
+    case SortMode::Radix:
+        RadixSortByKey(items, scratch);
+        return;
+    case SortMode::Counting:
+        if (!CountingSortByKey(items, scratch)) {
+            std::stable_sort(items.begin(), items.end(), KeyLess);
+        }
+        return;
+    case SortMode::Auto:
+        if (items.size() >= SmallLimit) {
+            if (SampleDistinctKeys(items, 1024, scratch) <= CountingSortMaxKeys / 4 && CountingSortByKey(items, scratch)) {
+                return;
+            }
+            RadixSortByKey(items, scratch);
+            return;
+        }
+        break;
+    default:
+        break;
+    }
+    std::stable_sort(items.begin(), items.end(), KeyLess);
+}
+
+inline bool KeyIndexLess(const KeyedIndex& a, const KeyedIndex& b) {
+    return a.key < b.key || (a.key == b.key && a.index < b.index);
+}
+
+// The k keys of a column that come first under `before`, with their row
+// indices, in that order. A bounded heap keeps this O(n log k).
+template <class Compare>
+std::vector<KeyedIndex> TopK(const std::vector<double>& keys, size_t k, Compare before) {
+    std::vector<KeyedIndex> heap;
+    k = std::min(k, keys.size());
+    if (k == 0) {
+        return heap;
+    }
+    heap.reserve(k);
+    for (size_t i = 0; i < keys.size(); i++) {
+        KeyedIndex item = { keys[i], i };
+        if (heap.size() < k) {
+            heap.push_back(item);
+            std::push_heap(heap.begin(), heap.end(), before);
+        } else if (before(item, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), before);
+            heap.back() = item;
+            std::push_heap(heap.begin(), heap.end(), before);
+        }
+    }
+    std::sort_heap(heap.begin(), heap.end(), before);
+    return heap;
+}
+
+// The k smallest keys of a column (e.g. CurveColumns::GetCircleRadii()),
+// ascending; ties go to the lower row.
+inline std::vector<KeyedIndex> SmallestK(const std::vector<double>& keys, size_t k) {
+    return TopK(keys, k, KeyIndexLess);
+}
+
+// The k largest keys of a column, descending; ties go to the lower row.
+inline std::vector<KeyedIndex> LargestK(const std::vector<double>& keys, size_t k) {
+    return TopK(keys, k, [](const KeyedIndex& a, const KeyedIndex& b) {
+        return a.key > b.key || (a.key == b.key && a.index < b.index);
+    });
+}
+
+// Exact quantile q in [0, 1], interpolating linearly between the two nearest
+// order statistics (q = 0.5 is the median). Two selections, O(n); takes the
+// values by copy because selection reorders them. NaN for an empty input.
+inline double Quantile(std::vector<double> values, double q) {
+    if (values.empty()) {
+        return NAN;
+    }
+    double rank = std::min(std::max(q, 0.0), 1.0) * (values.size() - 1);
+    size_t lower = static_cast<size_t>(rank);
+    std::nth_element(values.begin(), values.begin() + lower, values.end());
+    double low = values[lower];
+    if (lower + 1 == values.size()) {
+        return low;
+    }
+    double high = *std::min_element(values.begin() + lower + 1, values.end());
+    return low + (rank - lower) * (high - low);
+}
 
-class Ellipse : public Curve3D {
+// Streaming estimate of one quantile in O(1) memory: the P-square algorithm
+// (Jain and Chlamtac), which tracks five markers and adjusts them with
+// piecewise-parabolic interpolation. Meant for sets too large to keep or
+// select over; exact for the first five values.
+class QuantileSketch {
 private:
-    double radiusX;
-    double radiusY;
+    double q;
+    size_t count;
+    double heights[5];
+    double positions[5];
+    double desired[5];
+    double increments[5];
+
+    double Parabolic(int i, double d) const {
+        return heights[i] + d / (positions[i + 1] - positions[i - 1]) *
+            ((positions[i] - positions[i - 1] + d) * (heights[i + 1] - heights[i]) / (positions[i + 1] - positions[i]) +
+             (positions[i + 1] - positions[i] - d) * (heights[i] - heights[i - 1]) / (positions[i] - positions[i - 1]));
+    }
+
+    double Linear(int i, int d) const {
+        return heights[i] + d * (heights[i + d] - heights[i]) / (positions[i + d] - positions[i]);
+    }
 
 public:
-    Ellipse(double radiusX, double radiusY) : radiusX(radiusX), radiusY(radiusY) {}
+    explicit QuantileSketch(double q) : q(q), count(0), heights(), positions(), desired(), increments() {}
+
+    void Add(double x) {
+        if (count < 5) {
+            heights[count++] = x;
+            if (count == 5) {
+                std::sort(heights, heights + 5);
+                for (int i = 0; i < 5; i++) {
+                    positions[i] = i + 1.0;
+                }
+                desired[0] = 1.0;
+                desired[1] = 1.0 + 2.0 * q;
+                desired[2] = 1.0 + 4.0 * q;
+                desired[3] = 3.0 + 2.0 * q;
+                desired[4] = 5.0;
+                increments[0] = 0.0;
+                increments[1] = q / 2.0;
+                increments[2] = q;
+                increments[3] = (1.0 + q) / 2.0;
+                increments[4] = 1.0;
+            }
+            return;
+        }
 
-    Point3D GetPoint(double t) const override {
-        double x = radiusX * cos(t);
-        double y = radiusY * sin(t);
-        double z = 0.0;
+        int k;
+        if (x < heights[0]) {
+            heights[0] = x;
+            k = 0;
+        } else if (x >= heights[4]) {
+            heights[4] = x;
+            k = 3;
+        } else {
+            k = 0;
+            while (x >= heights[k + 1]) {
+                k++;
+            }
+        }
+        for (int i = k + 1; i < 5; i++) {
+            positions[i] += 1.0;
+        }
+        for (int i = 0; i < 5; i++) {
+            desired[i] += increments[i];
+        }
+        count++;
 
-        return { x, y, z };
+        for (int i = 1; i < 4; i++) {
+            double d = desired[i] - positions[i];
+            if ((d >= 1.0 && positions[i + 1] - positions[i] > 1.0) || (d <= -1.0 && positions[i - 1] - positions[i] < -1.0)) {
+                int sign = d > 0.0 ? 1 : -1;
+                double candidate = Parabolic(i, sign);
+                if (heights[i - 1] < candidate && candidate < heights[i + 1]) {
+                    heights[i] = candidate;
+                } else {
+                    heights[i] = Linear(i, sign);
+                }
+                positions[i] += sign;
+            }
+        }
     }
 
-    Point3D GetDerivative(double t) const override {
-        double x = -radiusX * sin(t);
-        double y = radiusY * cos(t);
-        double z = 0.0;
-
-        return { x, y, z };
+    double Estimate() const {
+        if (count >= 5) {
+            return heights[2];
+        }
+        std::vector<double> first(heights, heights + count);
+        return Quantile(first, q);
     }
 
-    double GetRadiusX() const { return radiusX; }
-    double GetRadiusY() const { return radiusY; }
+    size_t Count() const { return count; }
 };
 
-class Helix : public Curve3D {
+// How many of the first `outputs` elements of a stable merge of a and b come
+// from a; lets one merge be cut into independent, equally sized pieces.
+inline size_t MergeSplit(const KeyedIndex* a, size_t countA, const KeyedIndex* b, size_t countB, size_t outputs) {
+    size_t lo = outputs > countB ? outputs - countB : 0;
+    size_t hi = std::min(outputs, countA);
+    while (lo < hi) {
+        size_t i = lo + (hi - lo) / 2;
+        if (a[i].key <= b[outputs - i - 1].key) {
+            lo = i + 1;
+        } else {
+            hi = i;
+        }
+    }
+    return lo;
+}
+
+// Stable parallel merge sort: one run per thread sorted with std::stable_sort,
+// then rounds of pairwise merges, each split across all threads. Stability
+// fixes the output, so it does not depend on the thread count. Small inputs
+// are sorted sequentially.
+template <class Allocator>
+void ParallelSortByKey(std::vector<KeyedIndex, Allocator>& items, size_t threads = WorkerCount(),
+    std::pmr::memory_resource* scratch = std::pmr::get_default_resource()) {
+    const size_t SequentialLimit = 1 << 16;
+    size_t n = items.size();
+    if (n < SequentialLimit || threads <= 1) {
+        std::stable_sort(items.begin(), items.end(), KeyLess);
+        return;
+    }
+
+    size_t run = (n + threads - 1) / threads;
+    ParallelFor(threads, threads, [&](size_t i) {
+        size_t begin = std::min(n, i * run);
+        size_t end = std::min(n, begin + run);
+        std::stable_sort(items.begin() + begin, items.begin() + end, KeyLess);
+    });
+
+    std::pmr::vector<KeyedIndex> buffer(n, scratch);
+    KeyedIndex* source = items.data();
+    KeyedIndex* target = buffer.data();
+    for (; run < n; run *= 2) {
+        size_t pairs = (n + 2 * run - 1) / (2 * run);
+        size_t parts = std::max<size_t>(1, threads / pairs);
+        ParallelFor(pairs * parts, threads, [&](size_t task) {
+            size_t begin = task / parts * 2 * run;
+            size_t middle = std::min(n, begin + run);
+            size_t end = std::min(n, begin + 2 * run);
+            const KeyedIndex* a = source + begin;
+            const KeyedIndex* b = source + middle;
+            size_t countA = middle - begin;
+            size_t countB = end - middle;
+            size_t part = task % parts;
+            size_t first = (countA + countB) * part / parts;
+            size_t last = (countA + countB) * (part + 1) / parts;
+            size_t firstA = MergeSplit(a, countA, b, countB, first);
+            size_t lastA = MergeSplit(a, countA, b, countB, last);
+            std::merge(a + firstA, a + lastA, b + (first - firstA), b + (last - lastA), target + begin + first, KeyLess);
+        });
+        std::swap(source, target);
+    }
+
+    if (source != items.data()) {
+        std::copy(source, source + n, items.data());
+    }
+}
+
+// Reorders any collection (curve pointers, CurveValues, ...) by key(item),
+// e.g. std::mem_fn(&Circle::GetRadius) or &Helix::GetStep wrapped likewise.
+template <class T, class Allocator, class Key>
+void ParallelSortBy(std::vector<T, Allocator>& items, Key key, size_t threads = WorkerCount(),
+    std::pmr::memory_resource* scratch = std::pmr::get_default_resource()) {
+    const size_t Block = 1 << 16;
+    size_t n = items.size();
+    size_t blocks = (n + Block - 1) / Block;
+    std::pmr::vector<KeyedIndex> records(n, scratch);
+    ParallelFor(blocks, threads, [&](size_t block) {
+        for (size_t i = block * Block; i < std::min(n, (block + 1) * Block); i++) {
+            records[i] = { key(items[i]), i };
+        }
+    });
+    ParallelSortByKey(records, threads, scratch);
+
+    std::pmr::vector<T> sorted(items.begin(), items.end(), scratch);
+    ParallelFor(blocks, threads, [&](size_t block) {
+        for (size_t i = block * Block; i < std::min(n, (block + 1) * Block); i++) {
+            sorted[i] = items[records[i].index];
+        }
+    });
+    std::copy(sorted.begin(), sorted.end(), items.begin());
+}
+
+// Static range index over one parameter column. The keys are sorted together
+// with their row numbers, so every query answers with a contiguous slice of
+// GetRows(); the search runs over a copy of the keys in Eytzinger (BFS) order,
+// where each step is a branch-free descent and the next levels' nodes sit in
+// one prefetched cache line. Build after bulk inserts; it is O(n) past the sort.
+class RangeIndex {
 private:
-    double radius;
-    double step;
+    std::vector<double> keys;
+    std::vector<size_t> rows;
+    std::vector<double> tree;
+    std::vector<size_t> treeRank;
+
+    size_t FillTree(size_t node, size_t rank) {
+        if (node < tree.size()) {
+            rank = FillTree(2 * node, rank);
+            tree[node] = keys[rank];
+            treeRank[node] = rank;
+            rank = FillTree(2 * node + 1, rank + 1);
+        }
+        return rank;
+    }
+
+    // Rank of the first key for which goRight fails.
+    template <class GoRight>
+    size_t Search(GoRight goRight) const {
+        size_t n = keys.size();
+        uintptr_t base = reinterpret_cast<uintptr_t>(tree.data());
+        size_t node = 1;
+        while (node <= n) {
+            CURVE3D_PREFETCH(base + 8 * node * sizeof(double));
+            node = 2 * node + (goRight(tree[node]) ? 1 : 0);
+        }
+        while (node & 1) {
+            node >>= 1;
+        }
+        node >>= 1;
+        return node == 0 ? n : treeRank[node];
+    }
 
 public:
-    Helix(double radius, double step) : radius(radius), step(step) {}
+    RangeIndex() {}
+
+    explicit RangeIndex(const std::vector<double>& column) { Build(column); }
+
+    // The sort records and the sort's own buffers come from scratch.
+    void Build(const std::vector<double>& column, std::pmr::memory_resource* scratch = std::pmr::get_default_resource()) {
+        std::pmr::vector<KeyedIndex> records(column.size(), scratch);
+        for (size_t i = 0; i < column.size(); i++) {
+            records[i] = { column[i], i };
+        }
+        SortByKey(records, SortMode::Auto, scratch);
 
-    Point3D GetPoint(double t) const override {
-        double x = radius * cos(t);
-        double y = radius * sin(t);
-        double z = step * t / (2 * PI);
+        keys.resize(records.size());
+        rows.resize(records.size());
+        for (size_t i = 0; i < records.size(); i++) {
+            keys[i] = records[i].key;
+            rows[i] = records[i].index;
+        }
+        tree.assign(records.size() + 1, 0.0);
+        treeRank.assign(records.size() + 1, 0);
+        FillTree(1, 0);
+    }
 
-        return { x, y, z };
+    // Rank of the first key >= x.
+    size_t LowerBound(double x) const {
+        return Search([x](double key) { return key < x; });
     }
 
-    Point3D GetDerivative(double t) const override {
-        double x = -radius * sin(t);
-        double y = radius * cos(t);
-        double z = step / (2 * PI);
+    // Rank of the first key > x.
+    size_t UpperBound(double x) const {
+        return Search([x](double key) { return key <= x; });
+    }
 
-        return{ x, y, z };
+    // Ranks [first, last) of the keys in [lo, hi].
+    std::pair<size_t, size_t> Range(double lo, double hi) const {
+        size_t first = LowerBound(lo);
+        return { first, std::max(first, UpperBound(hi)) };
     }
 
-    double GetRadius() const { return radius; }
-    double GetStep() const { return step; }
+    size_t CountLess(double x) const { return LowerBound(x); }
+
+    size_t Size() const { return keys.size(); }
+
+    // Keys ascending and the column rows they came from, in the same order.
+    const std::vector<double>& GetKeys() const { return keys; }
+    const std::vector<size_t>& GetRows() const { return rows; }
+};
+
+template <class F>
+double MeasureSeconds(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void PrintTiming(const char* name, size_t count, double seconds) {
+    std::cout << "  " << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(2)
+        << seconds * 1e9 / count << " ns/item\n";
+}
+
+// Same randomly mixed curves evaluated through the vtable, through the vtable
+// of InlineCurve copies and through std::visit.
+void BenchmarkDispatch(size_t count) {
+    std::vector<CurveValue> values;
+    for (size_t i = 0; i < count; i++) {
+        double radius = (rand() % 10) + 1.0;
+        switch (rand() % 3) {
+        case 0: values.push_back(Circle(radius)); break;
+        case 1: values.push_back(Ellipse(radius, (rand() % 10) + 1.0)); break;
+        default: values.push_back(Helix(radius, (rand() % 5) + 1.0)); break;
+        }
+    }
+    std::vector<const Curve3D*> pointers;
+    std::vector<InlineCurve<48>> inlined;
+    for (const CurveValue& value : values) {
+        pointers.push_back(&AsCurve3D(value));
+        std::visit([&](const auto& c) { inlined.push_back(c); }, value);
+    }
+
+    double checksum = 0.0;
+    std::cout << "Dispatch, " << count << " curves:\n";
+    PrintTiming("virtual", count, MeasureSeconds([&] {
+        for (size_t i = 0; i < count; i++) {
+            Point3D point = pointers[i]->GetPoint(i * 1e-3);
+            checksum += point.x + point.y + point.z;
+        }
+    }));
+    PrintTiming("InlineCurve", count, MeasureSeconds([&] {
+        for (size_t i = 0; i < count; i++) {
+            Point3D point = inlined[i].GetPoint(i * 1e-3);
+            checksum -= point.x + point.y + point.z;
+        }
+    }));
+    PrintTiming("std::visit", count, MeasureSeconds([&] {
+        for (size_t i = 0; i < count; i++) {
+            Point3D point = GetPoint(values[i], i * 1e-3);
+            checksum -= point.x + point.y + point.z;
+        }
+    }));
+    std::cout << "  checksum " << checksum << "\n";
+}
+
+// Sorting circles by radius: std::sort over heap-allocated Circle pointers,
+// as main used to do, against radix sorting (radius, index) records.
+void BenchmarkSort(size_t count) {
+    std::mt19937_64 random(count);
+    std::uniform_real_distribution<double> radius(1.0, 10.0);
+    std::vector<std::unique_ptr<Circle>> owned;
+    for (size_t i = 0; i < count; i++) {
+        owned.push_back(std::make_unique<Circle>(radius(random)));
+    }
+    std::vector<Circle*> circles;
+    for (const auto& circle : owned) {
+        circles.push_back(circle.get());
+    }
+    std::shuffle(circles.begin(), circles.end(), random);
+
+    std::cout << "Sort by radius, " << count << " circles:\n";
+    PrintTiming("std::sort pointers", count, MeasureSeconds([&] {
+        std::sort(circles.begin(), circles.end(), [](Circle* a, Circle* b) {
+            return a->GetRadius() < b->GetRadius();
+        });
+    }));
+    std::shuffle(circles.begin(), circles.end(), random);
+    PrintTiming("radix sort records", count, MeasureSeconds([&] {
+        std::vector<KeyedIndex> records(count);
+        for (size_t i = 0; i < count; i++) {
+            records[i] = { circles[i]->GetRadius(), i };
+        }
+        RadixSortByKey(records);
+    }));
+    std::shuffle(circles.begin(), circles.end(), random);
+    PrintTiming("parallel sort pointers", count, MeasureSeconds([&] {
+        ParallelSortBy(circles, std::mem_fn(&Circle::GetRadius));
+    }));
+
+    std::vector<KeyedIndex> quantized(count);
+    for (size_t i = 0; i < count; i++) {
+        quantized[i] = { (rand() % 10) + 1.0, i };
+    }
+    std::vector<KeyedIndex> records = quantized;
+    PrintTiming("radix, 10 radii", count, MeasureSeconds([&] { RadixSortByKey(records); }));
+    records = quantized;
+    PrintTiming("auto, 10 radii", count, MeasureSeconds([&] { SortByKey(records); }));
+}
+
+// Building mixed curves one heap block each against carving them out of an
+// arena, then walking the pointers; tearing down is timed as part of each.
+void BenchmarkConstruction(size_t count) {
+    std::vector<double> radii(count);
+    for (size_t i = 0; i < count; i++) {
+        radii[i] = (rand() % 10) + 1.0;
+    }
+    auto iterate = [&](const std::vector<Curve3D*>& curves) {
+        double checksum = 0.0;
+        for (size_t i = 0; i < count; i++) {
+            Point3D point = curves[i]->GetPoint(i * 1e-3);
+            checksum += point.x + point.y + point.z;
+        }
+        return checksum;
+    };
+
+    std::cout << "Construction, " << count << " curves:\n";
+    double checksum = 0.0;
+    std::vector<Curve3D*> curves(count);
+    {
+        std::vector<std::unique_ptr<Circle>> circles;
+        std::vector<std::unique_ptr<Ellipse>> ellipses;
+        std::vector<std::unique_ptr<Helix>> helices;
+        circles.reserve(count / 3 + 1);
+        ellipses.reserve(count / 3 + 1);
+        helices.reserve(count / 3 + 1);
+        PrintTiming("make_unique", count, MeasureSeconds([&] {
+            for (size_t i = 0; i < count; i++) {
+                switch (i % 3) {
+                case 0:
+                    circles.push_back(std::make_unique<Circle>(radii[i]));
+                    curves[i] = circles.back().get();
+                    break;
+                case 1:
+                    ellipses.push_back(std::make_unique<Ellipse>(radii[i], radii[count - 1 - i]));
+                    curves[i] = ellipses.back().get();
+                    break;
+                default:
+                    helices.push_back(std::make_unique<Helix>(radii[i], 2.0));
+                    curves[i] = helices.back().get();
+                    break;
+                }
+            }
+        }));
+        PrintTiming("iterate heap", count, MeasureSeconds([&] { checksum += iterate(curves); }));
+        PrintTiming("free heap", count, MeasureSeconds([&] {
+            circles.clear();
+            ellipses.clear();
+            helices.clear();
+        }));
+    }
+    {
+        CurveArena arena(1 << 21, true);
+        PrintTiming("arena", count, MeasureSeconds([&] {
+            for (size_t i = 0; i < count; i++) {
+                switch (i % 3) {
+                case 0: curves[i] = arena.Create<Circle>(radii[i]); break;
+                case 1: curves[i] = arena.Create<Ellipse>(radii[i], radii[count - 1 - i]); break;
+                default: curves[i] = arena.Create<Helix>(radii[i], 2.0); break;
+                }
+            }
+        }));
+        PrintTiming("iterate arena", count, MeasureSeconds([&] { checksum -= iterate(curves); }));
+        PrintTiming("free arena", count, MeasureSeconds([&] { arena.Release(); }));
+    }
+    std::cout << "  checksum " << checksum << "\n";
+}
+
+// One evaluation pass over mixed curves stored as classes grouped by type
+// and as double and float records; the records only read their 32 or 16 bytes.
+void BenchmarkRecords(size_t count) {
+    CurveSet set;
+    for (size_t i = 0; i < count; i++) {
+        double radius = (rand() % 10) + 1.0;
+        switch (i % 3) {
+        case 0: set.Add(Circle(radius)); break;
+        case 1: set.Add(Ellipse(radius, (rand() % 10) + 1.0)); break;
+        default: set.Add(Helix(radius, (rand() % 5) + 1.0)); break;
+        }
+    }
+    std::vector<CurveRecord<double>> wide = MakeRecords<double>(set);
+    std::vector<CurveRecord<float>> narrow = MakeRecords<float>(set);
+    std::vector<Point3D> points(count);
+    std::vector<Point3D> derivatives(count);
+    const int Passes = 10;
+
+    std::cout << "Evaluate all, " << count << " curves:\n";
+    PrintTiming("CurveSet", count * Passes, MeasureSeconds([&] {
+        for (int pass = 0; pass < Passes; pass++) {
+            set.EvaluateAll(pass * 0.1, points.data(), derivatives.data());
+        }
+    }));
+    PrintTiming("CurveRecord<double>", count * Passes, MeasureSeconds([&] {
+        for (int pass = 0; pass < Passes; pass++) {
+            EvaluateAll(wide.data(), count, pass * 0.1, points.data(), derivatives.data());
+        }
+    }));
+    PrintTiming("CurveRecord<float>", count * Passes, MeasureSeconds([&] {
+        for (int pass = 0; pass < Passes; pass++) {
+            EvaluateAll(narrow.data(), count, pass * 0.1, points.data(), derivatives.data());
+        }
+    }));
+}
+
+// Double and float batches over the same parameters, and the float error:
+// the largest coordinate difference scaled by the largest coordinate of the
+// double result, so it reads as relative to the size of the curve.
+void BenchmarkFloat(size_t count) {
+    std::mt19937_64 random(count);
+    std::uniform_real_distribution<float> parameter(-100.0f, 100.0f);
+    std::vector<float> ts(count);
+    for (float& t : ts) {
+        t = parameter(random);
+    }
+    std::vector<double> wide(ts.begin(), ts.end());
+    std::vector<Point3D> points(count);
+    std::vector<Point3D> derivatives(count);
+    std::vector<Point3F> narrowPoints(count);
+    std::vector<Point3F> narrowDerivatives(count);
+
+    auto error = [](const Point3D& expected, const Point3F& actual) {
+        double scale = std::max({ fabs(expected.x), fabs(expected.y), fabs(expected.z) });
+        double difference = std::max({ fabs(actual.x - expected.x), fabs(actual.y - expected.y), fabs(actual.z - expected.z) });
+        return difference / scale;
+    };
+
+    Ellipse ellipse(4.0, 1.5);
+    Helix helix(3.0, 2.0);
+    for (const Curve3D* curve : { static_cast<const Curve3D*>(&ellipse), static_cast<const Curve3D*>(&helix) }) {
+        std::cout << (curve->GetKind() == CurveKind::Helix ? "Helix" : "Ellipse") << ", " << count << " points and derivatives:\n";
+        PrintTiming("double", count, MeasureSeconds([&] {
+            curve->GetPointsAndDerivatives(wide.data(), points.data(), derivatives.data(), count);
+        }));
+        PrintTiming("float", count, MeasureSeconds([&] {
+            curve->GetPointsAndDerivativesF(ts.data(), narrowPoints.data(), narrowDerivatives.data(), count);
+        }));
+        double worst = 0.0;
+        for (size_t i = 0; i < count; i++) {
+            worst = std::max({ worst, error(points[i], narrowPoints[i]), error(derivatives[i], narrowDerivatives[i]) });
+        }
+        std::cout << "  float error " << std::scientific << std::setprecision(2) << worst << std::fixed << "\n";
+    }
+}
+
+// Worst sin/cos error of a batch kernel over count uniform samples in
+// [-range, range], against sin/cos evaluated in Wide.
+struct SinCosError {
+    double ulps;
+    double absolute;
 };
 
-int main() {
-    std::vector<std::unique_ptr<Curve3D>> curves;
+template <class Real, class Wide, class Kernel>
+SinCosError MeasureSinCos(Kernel sinCos, Real range, size_t count) {
+    const size_t Batch = 1 << 16;
+    std::mt19937_64 random(count);
+    std::uniform_real_distribution<Real> parameter(-range, range);
+    std::vector<Real> ts(Batch);
+    std::vector<Real> s(Batch);
+    std::vector<Real> c(Batch);
+    SinCosError worst = { 0.0, 0.0 };
+    auto measure = [&](Real value, Wide reference) {
+        double error = static_cast<double>(std::fabs(value - reference));
+        worst.absolute = std::max(worst.absolute, error);
+        if (reference != 0) {
+            Wide ulp = std::ldexp(Wide(1), std::ilogb(reference) - (std::numeric_limits<Real>::digits - 1));
+            worst.ulps = std::max(worst.ulps, static_cast<double>(error / ulp));
+        }
+    };
+    for (size_t done = 0; done < count; done += Batch) {
+        size_t length = std::min(Batch, count - done);
+        for (size_t i = 0; i < length; i++) {
+            ts[i] = parameter(random);
+        }
+        sinCos(ts.data(), s.data(), c.data(), length);
+        for (size_t i = 0; i < length; i++) {
+            measure(s[i], std::sin(Wide(ts[i])));
+            measure(c[i], std::cos(Wide(ts[i])));
+        }
+    }
+    return worst;
+}
+
+void PrintError(const char* name, double range, const SinCosError& error) {
+    std::cout << "  " << std::left << std::setw(8) << name << "|t| <= " << std::setw(8) << std::defaultfloat << std::setprecision(6) << range
+              << std::right << std::fixed << std::setprecision(2) << std::setw(6) << error.ulps << " ulp  "
+              << std::scientific << error.absolute << std::fixed << "\n";
+}
+
+// Reproduces the error bounds stated for SinCosPack against a wider reference,
+// for every ISA the CPU supports and for std::sin/std::cos alongside.
+void RunChecks(size_t count) {
+    std::vector<Isa> isas;
+    for (Isa isa : { Isa::Scalar, Isa::Sse2, Isa::Avx2, Isa::Avx512 }) {
+        if (isa <= DetectIsa()) {
+            isas.push_back(isa);
+        }
+    }
+    auto libm = [](const auto* ts, auto* s, auto* c, size_t length) {
+        for (size_t i = 0; i < length; i++) {
+            s[i] = std::sin(ts[i]);
+            c[i] = std::cos(ts[i]);
+        }
+    };
+
+    std::cout << "Double sin/cos against long double (" << std::numeric_limits<long double>::digits << "-bit mantissa), "
+              << count << " samples per range:\n";
+    if (std::numeric_limits<long double>::digits <= std::numeric_limits<double>::digits) {
+        std::cout << "  long double is double here, so these only compare against std::sin/std::cos\n";
+    }
+    for (double range : { 1.0, 1e3, SinCosLimit }) {
+        for (Isa isa : isas) {
+            PrintError(IsaName(isa), range, MeasureSinCos<double, long double>(KernelsFor(isa).sinCos, range, count));
+        }
+        PrintError("libm", range, MeasureSinCos<double, long double>(libm, range, count));
+    }
+
+    std::cout << "Float sin/cos against double, " << count << " samples per range:\n";
+    for (float range : { 1.0f, SinCosFloatLimit }) {
+        for (Isa isa : isas) {
+            PrintError(IsaName(isa), range, MeasureSinCos<float, double>(KernelsFor(isa).sinCosFloat, range, count));
+        }
+        PrintError("libm", range, MeasureSinCos<float, double>(libm, range, count));
+    }
+}
+
+void RunBenchmarks(size_t maxCount) {
+    BenchmarkDispatch(std::min<size_t>(maxCount, 1000000));
+    BenchmarkConstruction(std::min<size_t>(maxCount, 1000000));
+    BenchmarkFloat(std::min<size_t>(maxCount, 1000000));
+    for (size_t count = 10000; count <= std::min<size_t>(maxCount, 1000000); count *= 10) {
+        BenchmarkRecords(count);
+    }
+    for (size_t count = 10000; count <= maxCount; count *= 10) {
+        BenchmarkSort(count);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        size_t maxCount = argc > 2 ? static_cast<size_t>(std::stod(argv[2])) : 10000000;
+        RunBenchmarks(maxCount);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--check") {
+        RunChecks(argc > 2 ? static_cast<size_t>(std::stod(argv[2])) : 1 << 22);
+        return 0;
+    }
+
+    // The set lives for the whole run; everything after it is per-request
+    // scratch that is dropped at once with the monotonic buffer.
+    std::pmr::unsynchronized_pool_resource pool;
+    CurveSet curves(&pool);
     srand(time(NULL));
 
     for (int i = 0; i < 5; i++) {
         double radius = (rand() % 10) + 1.0;
-        curves.push_back(std::make_unique<Circle>(radius));
+        curves.Add(Circle(radius));
     }
 
     for (int i = 0; i < 5; i++) {
         double radiusX = (rand() % 10) + 1.0;
         double radiusY = (rand() % 10) + 1.0;
-        curves.push_back(std::make_unique<Ellipse>(radiusX, radiusY));
+        curves.Add(Ellipse(radiusX, radiusY));
     }
 
     for (int i = 0; i < 5; i++) {
         double radius = (rand() % 10) + 1.0;
         double step = (rand() % 5) + 1.0;
-        curves.push_back(std::make_unique<Helix>(radius, step));
+        curves.Add(Helix(radius, step));
     }
 
-    for (const auto& curve : curves) {
-        Point3D point = curve->GetPoint(PI / 4);
-        Point3D derivative = curve->GetDerivative(PI / 4);
+    char buffer[16384];
+    std::pmr::monotonic_buffer_resource scratch(buffer, sizeof(buffer));
+    std::pmr::vector<Point3D> points(curves.Size(), &scratch);
+    std::pmr::vector<Point3D> derivatives(curves.Size(), &scratch);
+    curves.EvaluateAll(PI / 4, points.data(), derivatives.data());
+
+    for (size_t i = 0; i < curves.Size(); i++) {
+        const Point3D& point = points[i];
+        const Point3D& derivative = derivatives[i];
         std::cout << "Point: (" << point.x << ", " << point.y << ", " << point.z << "), ";
         std::cout << "Derivative: (" << derivative.x << ", " << derivative.y << ", " << derivative.z << ")\n";
     }
 
-    std::vector<Circle*> circles;
-    for (const auto& curve : curves) {
-        if (dynamic_cast<Circle*>(curve.get())) {
-            circles.push_back(static_cast<Circle*>(curve.get()));
-        }
+    const std::pmr::vector<Circle>& allCircles = curves.GetCircles();
+    std::pmr::vector<KeyedIndex> byRadius(&scratch);
+    for (size_t i = 0; i < allCircles.size(); i++) {
+        byRadius.push_back({ allCircles[i].GetRadius(), i });
     }
+    SortByKey(byRadius, SortMode::Auto, &scratch);
 
-    std::sort(circles.begin(), circles.end(), [](Circle* a, Circle* b) {
-        return a->GetRadius() < b->GetRadius();
-    });
+    std::pmr::vector<const Circle*> circles(&scratch);
+    for (const KeyedIndex& item : byRadius) {
+        circles.push_back(&allCircles[item.index]);
+    }
 
     double totalRadius = 0.0;
-    for (const auto& circle : circles) {
+    for (const Circle* circle : circles) {
         totalRadius += circle->GetRadius();
     }
 